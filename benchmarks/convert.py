@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+"""How long it takes to convert nested structures between Python and
+JavaScript. Run it before and after a change to the conversion code, saving
+the first run and comparing the second against it:
+
+    git checkout HEAD^ && python setup.py build_ext --inplace
+    python benchmarks/convert.py --save before.json
+    git checkout - && python setup.py build_ext --inplace
+    python benchmarks/convert.py --compare before.json
+"""
+from __future__ import print_function, division
+
+import json
+import sys
+import timeit
+
+from v8py import Context
+
+
+def record(i):
+    return {'id': i, 'name': 'item %d' % i, 'price': i * 0.25, 'tags': ['a', 'b'], 'active': i % 2 == 0}
+
+WORKLOADS = [
+    ('10k-key dict', {'key%d' % i: i for i in range(10000)}),
+    ('10k records', [record(i) for i in range(10000)]),
+    ('1M floats', [i * 0.5 for i in range(1000000)]),
+    ('1M ints', list(range(1000000))),
+    ('nested', {'level%d' % i: {'items': [record(j) for j in range(50)]} for i in range(200)}),
+]
+
+
+def best(function, number):
+    return min(timeit.repeat(function, number=number, repeat=5)) / number
+
+
+def measure():
+    context = Context()
+    identity = context.eval('(function (x) { return x; })')
+    noop = context.eval('(function (x) { })')
+
+    times = {}
+    for name, value in WORKLOADS:
+        context.value = value
+        times[name + ' py -> js'] = best(lambda: noop(value), 5)
+        times[name + ' js -> py'] = best(lambda: context.eval('value'), 5)
+    # both ways through a function call, the way most values cross
+    times['round trip'] = best(lambda: identity(WORKLOADS[1][1]), 5)
+    return times
+
+
+def main():
+    args = sys.argv[1:]
+    before = None
+    if len(args) == 2 and args[0] == '--compare':
+        with open(args[1]) as f:
+            before = json.load(f)
+
+    times = measure()
+    names = [name + direction for name, _ in WORKLOADS for direction in (' py -> js', ' js -> py')]
+    for name in names + ['round trip']:
+        line = '{:<24}{:>11.2f} ms'.format(name, times[name] * 1000)
+        if before is not None and name in before:
+            line += '{:>11.2f} ms before, {:.2f}x'.format(before[name] * 1000, before[name] / times[name])
+        print(line)
+
+    if len(args) == 2 and args[0] == '--save':
+        with open(args[1], 'w') as f:
+            json.dump(times, f, indent=2)
+
+
+if __name__ == '__main__':
+    main()
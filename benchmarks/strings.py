@@ -0,0 +1,56 @@
+#!/usr/bin/env python
+"""How fast strings cross between Python and JavaScript, in GB/s of UTF-16.
+
+Run it with the extension built in place:
+
+    python benchmarks/strings.py [size in KiB]
+
+benchmarks/transcode.cpp times the SIMD and scalar kernels on their own.
+"""
+from __future__ import print_function, division
+
+import sys
+import timeit
+
+from v8py import Context
+
+KINDS = [
+    ('ascii', u'<p>The quick brown fox jumps over the lazy dog.</p>\n'),
+    ('latin-1', u'<p>Voil\xe0 le caf\xe9 cr\xe8me br\xfbl\xe9e.</p>\n'),
+    ('bmp', u'<p>東京都 Москва €100</p>\n'),
+    ('astral', u'<p>\U0001f600 emoji \U0001f680 and \U00010348 text</p>\n'),
+]
+
+
+def document(piece, size):
+    return (piece * (size // len(piece) + 1))[:size]
+
+
+def throughput(seconds, runs, string):
+    utf16_bytes = len(string.encode('utf-16-le'))
+    return utf16_bytes * runs / seconds / 1e9
+
+
+def main():
+    size = int(sys.argv[1]) * 1024 if len(sys.argv) > 1 else 1024 * 1024
+    context = Context()
+    identity = context.eval('(function (s) { return s; })')
+    length = context.eval('(function (s) { return s.length; })')
+
+    print('{:<10}{:>14}{:>14}{:>14}'.format('', 'py -> js', 'js -> py', 'round trip'))
+    for name, piece in KINDS:
+        string = document(piece, size)
+        runs = max(10, 64 * 1024 * 1024 // size)
+        to_js = min(timeit.repeat(lambda: length(string), number=runs, repeat=3))
+        context.string = string
+        to_py = min(timeit.repeat(lambda: context.eval('string'), number=runs, repeat=3))
+        both = min(timeit.repeat(lambda: identity(string), number=runs, repeat=3))
+        print('{:<10}{:>9.2f} GB/s{:>9.2f} GB/s{:>9.2f} GB/s'.format(
+            name,
+            throughput(to_js, runs, string),
+            throughput(to_py, runs, string),
+            throughput(both, runs, string)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,133 @@
+// How fast the string kernels in v8py/transcode.cpp are on their own, in GB
+// of input per second, for each implementation this CPU can run. This is
+// the part strings.py can't show, since there the kernels are buried under
+// V8's and CPython's allocation and copying.
+//
+// It includes transcode.cpp itself to get at the static per-ISA versions, so
+// it needs neither Python nor V8. Build it with the flags setup.py uses:
+//
+//     c++ -O2 -std=c++11 -o transcode benchmarks/transcode.cpp
+//     ./transcode [size in KiB]
+
+#include "../v8py/transcode.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+// keeps the compiler from throwing away results nobody reads
+static volatile size_t sink;
+
+// fastest of a few runs, in GB/s of input
+template <class F> static double throughput(size_t bytes, F kernel) {
+    size_t runs = 64 * 1024 * 1024 / bytes + 10;
+    double best = 0;
+    for (int repeat = 0; repeat < 5; repeat++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < runs; i++) {
+            sink = kernel();
+        }
+        std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        double rate = bytes * (double) runs / seconds.count() / 1e9;
+        if (rate > best) best = rate;
+    }
+    return best;
+}
+
+// the same pieces benchmarks/strings.py repeats into documents
+static std::vector<uint32_t> document(const char *name, size_t size) {
+    static const uint32_t ascii[] = {'<', 'p', '>', 'T', 'h', 'e', ' ', 'q', 'u', 'i', 'c', 'k', ' ', 'f', 'o', 'x', '.', '\n'};
+    static const uint32_t latin1[] = {'V', 'o', 'i', 'l', 0xe0, ' ', 'c', 'a', 'f', 0xe9, ' ', 'c', 'r', 0xe8, 'm', 'e', '\n'};
+    static const uint32_t bmp[] = {'<', 'p', '>', 0x6771, 0x4eac, 0x90fd, ' ', 0x41c, 0x43e, 0x441, 0x43a, 0x432, 0x430, ' ', 0x20ac, '1', '\n'};
+    static const uint32_t astral[] = {'<', 'p', '>', 0x1f600, ' ', 'e', 'm', 'o', 'j', 'i', ' ', 0x1f680, ' ', 0x10348, '\n'};
+    const uint32_t *piece;
+    size_t length;
+    if (!strcmp(name, "ascii")) piece = ascii, length = sizeof(ascii) / 4;
+    else if (!strcmp(name, "latin-1")) piece = latin1, length = sizeof(latin1) / 4;
+    else if (!strcmp(name, "bmp")) piece = bmp, length = sizeof(bmp) / 4;
+    else piece = astral, length = sizeof(astral) / 4;
+
+    std::vector<uint32_t> chars(size);
+    for (size_t i = 0; i < size; i++) {
+        chars[i] = piece[i % length];
+    }
+    return chars;
+}
+
+struct impl {
+    const char *name;
+    bool (*is_ascii)(const uint8_t *, size_t);
+    int (*classify)(const uint16_t *, size_t);
+    void (*to_latin1)(const uint16_t *, size_t, uint8_t *);
+    size_t (*to_ucs4)(const uint16_t *, size_t, uint32_t *);
+    size_t (*to_utf16)(const uint32_t *, size_t, uint16_t *);
+};
+
+static int classify_scalar(const uint16_t *data, size_t length) {
+    return utf16_classify_scalar(data, length, 0);
+}
+
+int main(int argc, char **argv) {
+    size_t size = argc > 1 ? (size_t) atol(argv[1]) * 1024 : 1024 * 1024;
+    transcode_init();
+
+    std::vector<impl> impls;
+    impls.push_back({"scalar", latin1_is_ascii_scalar, classify_scalar, utf16_to_latin1_scalar,
+            utf16_to_ucs4_scalar, ucs4_to_utf16_scalar});
+#ifdef TRANSCODE_SSE2
+    impls.push_back({"sse2", latin1_is_ascii_sse2, utf16_classify_sse2, utf16_to_latin1_sse2,
+            utf16_to_ucs4_sse2, ucs4_to_utf16_sse2});
+#endif
+#ifdef TRANSCODE_AVX2
+    if (use_avx2) {
+        impls.push_back({"avx2", latin1_is_ascii_avx2, utf16_classify_avx2, utf16_to_latin1_avx2,
+                utf16_to_ucs4_avx2, ucs4_to_utf16_avx2});
+    }
+#endif
+
+    printf("%zu KiB documents, GB/s of input\n\n", size / 1024);
+    printf("%-9s%-18s", "", "kernel");
+    for (size_t i = 0; i < impls.size(); i++) printf("%10s", impls[i].name);
+    printf("\n");
+
+    const char *kinds[] = {"ascii", "latin-1", "bmp", "astral"};
+    for (const char *kind : kinds) {
+        // size is in characters of UTF-16, like strings.py
+        std::vector<uint32_t> ucs4 = document(kind, size / 2);
+        std::vector<uint16_t> utf16(ucs4.size() * 2);
+        utf16.resize(ucs4_to_utf16_scalar(ucs4.data(), ucs4.size(), utf16.data()));
+        std::vector<uint8_t> latin1(utf16.size());
+        for (size_t i = 0; i < utf16.size(); i++) latin1[i] = (uint8_t) utf16[i];
+        std::vector<uint32_t> ucs4_out(utf16.size());
+        std::vector<uint16_t> utf16_out(ucs4.size() * 2);
+        bool one_byte = !strcmp(kind, "ascii") || !strcmp(kind, "latin-1");
+
+        #define ROW(label, expr, bytes) do { \
+            printf("%-9s%-18s", kind, label); \
+            for (size_t i = 0; i < impls.size(); i++) { \
+                const impl &k = impls[i]; \
+                printf("%10.2f", throughput(bytes, [&]() { return (size_t) (expr); })); \
+            } \
+            printf("\n"); \
+        } while (0)
+
+        // the scans stop at the first byte that decides the answer, so they're
+        // only timed on documents they have to read to the end
+        if (!strcmp(kind, "ascii")) {
+            ROW("latin1_is_ascii", k.is_ascii(latin1.data(), latin1.size()), latin1.size());
+        }
+        if (strcmp(kind, "astral")) {
+            ROW("utf16_classify", k.classify(utf16.data(), utf16.size()), utf16.size() * 2);
+        }
+        if (one_byte) {
+            ROW("utf16_to_latin1", (k.to_latin1(utf16.data(), utf16.size(), latin1.data()), latin1[0]),
+                    utf16.size() * 2);
+        } else {
+            ROW("utf16_to_ucs4", k.to_ucs4(utf16.data(), utf16.size(), ucs4_out.data()), utf16.size() * 2);
+            ROW("ucs4_to_utf16", k.to_utf16(ucs4.data(), ucs4.size(), utf16_out.data()), ucs4.size() * 4);
+        }
+        #undef ROW
+    }
+    return 0;
+}
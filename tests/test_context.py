@@ -1,7 +1,10 @@
+import os
 import pytest
+import sys
+import threading
 import time
 
-from v8py import JavaScriptTerminated, current_context, new
+from v8py import Context, Isolate, JavaScriptTerminated, current_context, new
 
 def test_glob(context):
     context.eval('foo = "bar"')
@@ -41,6 +44,83 @@ def test_timeout_property(context_with_timeout):
     diff = time.time() - start
     assert diff >= 0.25 and diff < 0.3
 
+def test_timeout_cheap_to_arm(context_with_timeout):
+    context_with_timeout.eval('obj = {foo: 1}')
+    obj = context_with_timeout.glob.obj
+    start = time.time()
+    for i in range(10000):
+        assert obj.foo == 1
+    # arming a deadline used to start and join a thread
+    assert time.time() - start < 1
+
+def test_timeout_after_timeout(context_with_timeout):
+    for i in range(3):
+        with pytest.raises(JavaScriptTerminated):
+            context_with_timeout.eval('for(;;) {}')
+        assert context_with_timeout.eval('1 + 1') == 2
+
+@pytest.mark.skipif(not hasattr(os, 'fork'), reason='needs fork')
+def test_timeout_after_fork():
+    Context().eval('1', timeout=0.1)
+    pid = os.fork()
+    if pid == 0:
+        try:
+            Context().eval('for(;;) {}', timeout=0.1)
+        except JavaScriptTerminated:
+            os._exit(0)
+        finally:
+            os._exit(1)
+    for i in range(100):
+        done, status = os.waitpid(pid, os.WNOHANG)
+        if done:
+            break
+        time.sleep(0.1)
+    else:
+        os.kill(pid, 9)
+        os.waitpid(pid, 0)
+        pytest.fail('the timeout never fired in the child')
+    assert os.WIFEXITED(status) and os.WEXITSTATUS(status) == 0
+
+def test_nested_timeout(context):
+    def inner():
+        with pytest.raises(JavaScriptTerminated):
+            context.eval('for(;;) {}', timeout=0.1)
+        return 'survived'
+    context.expose(inner)
+    # only the inner eval ran out of time, the outer one keeps going
+    assert context.eval('inner() + "!"', timeout=5) == 'survived!'
+
+def test_nested_timeout_outer_expires(context):
+    def inner():
+        context.eval('for(;;) {}', timeout=5)
+    context.expose(inner)
+    start = time.time()
+    with pytest.raises(JavaScriptTerminated):
+        context.eval('inner()', timeout=0.1)
+    assert time.time() - start < 1
+
+def test_cpu_timeout(context):
+    with pytest.raises(JavaScriptTerminated):
+        context.eval('for(;;) {}', cpu_timeout=0.1)
+
+def test_cpu_timeout_property():
+    context = Context(cpu_timeout=0.1)
+    assert context.cpu_timeout == 0.1
+    with pytest.raises(JavaScriptTerminated):
+        context.eval('for(;;) {}')
+    context.cpu_timeout = 0
+    assert context.eval('1 + 1') == 2
+
+def test_cpu_timeout_ignores_sleep(context):
+    context.expose_module(time)
+    # sleeping takes wall time but no CPU time
+    context.eval('time.sleep(0.3); 1', cpu_timeout=0.1)
+
+def test_cpu_time(context):
+    context.eval('var x = 0; for (var i = 0; i < 10000000; i++) x += i')
+    assert context.last_cpu_time > 0
+    assert context.cpu_time >= context.last_cpu_time
+
 def test_timeout_context_level(context_with_timeout):
     with pytest.raises(JavaScriptTerminated):
         context_with_timeout.eval('for(;;) {}')
@@ -108,3 +188,61 @@ def test_current_context(context):
         assert current_context() is context
     context.expose(f)
     context.eval('f()')
+
+def test_release_gil():
+    context = Context(release_gil=True)
+    assert context.release_gil
+    ticks = []
+    stop = threading.Event()
+    def tick():
+        while not stop.is_set():
+            ticks.append(None)
+            time.sleep(0.001)
+    thread = threading.Thread(target=tick)
+    thread.start()
+    try:
+        context.eval('var end = Date.now() + 200; while (Date.now() < end);')
+        # the other thread only gets to run if eval let go of the GIL
+        assert len(ticks) > 10
+    finally:
+        stop.set()
+        thread.join()
+
+def test_release_gil_callback():
+    context = Context(release_gil=True)
+    def f(x): return x * 2
+    context.expose(f)
+    assert context.eval('f(21)') == 42
+    context.eval('function g(x) { return f(x) + 1; }')
+    assert context.glob.g(1) == 3
+
+def test_release_gil_contended():
+    # one thread runs JavaScript without the GIL and calls back into Python,
+    # another keeps reading from the same isolate
+    isolate = Isolate()
+    context = Context(release_gil=True, isolate=isolate)
+    other = Context(isolate=isolate)
+    other.eval('value = 1')
+    def f(): return 1
+    context.expose(f)
+    thread = threading.Thread(target=context.eval,
+            args=('var end = Date.now() + 200, n = 0; while (Date.now() < end) n += f();',))
+    thread.start()
+    reads = 0
+    while thread.is_alive():
+        reads += other.glob.value
+    thread.join()
+    assert reads > 0
+    assert context.eval('n') > 0
+
+def test_failed_context_releases_isolate():
+    class Broken(object):
+        def __init__(self):
+            raise RuntimeError('no global for you')
+    isolate = Isolate()
+    refs = sys.getrefcount(isolate)
+    with pytest.raises(RuntimeError):
+        Context(Broken, isolate=isolate)
+    with pytest.raises(ValueError):
+        Context(isolate=isolate, script_retention='some')
+    assert sys.getrefcount(isolate) == refs
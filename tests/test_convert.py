@@ -1,4 +1,9 @@
-from v8py import Null
+import array
+import sys
+import pytest
+
+from v8py import Context, Null, BufferCopy, JSBuffer, JSObject, JSMapping, JSSequence, \
+    set_external_string_threshold
 
 def test_convert_to_py(context):
     assert context.eval('"Hello, world!"') == 'Hello, world!'
@@ -55,3 +60,194 @@ def test_convert_to_js(context):
     assert context.eval('foo[2] == 3')
     context.glob.foo = {'foo': 'bar'}
     assert context.eval('foo.foo == "bar"')
+
+def test_string_representations(context):
+    strings = ['ascii', u'latin-1 \xe9\xff', u'two-byte €中', u'astral \U0001f600',
+               u'﻿leading bom', '', u'\xe9' * 2000, u'€' * 2000]
+    for string in strings:
+        context.string = string
+        assert context.eval('string') == string
+        assert context.eval('string.length') == len(string.encode('utf-16-le')) // 2
+    assert context.eval('"\\u00e9"') == u'\xe9'
+    assert context.eval('"\\ud83d\\ude00"') == u'\U0001f600'
+
+def test_string_transcoding(context):
+    # long enough to go through the vector loops, with pairs straddling blocks
+    for prefix in range(20):
+        string = u'a' * prefix + u'\U0001f600x€' * 300 + u'\xe9'
+        context.string = string
+        assert context.eval('string') == string
+        assert context.eval('string.length') == prefix + 300 * 4 + 1
+    # a two-byte string that only holds Latin-1 still comes back canonical
+    assert context.eval('("€" + "caf\\u00e9" + "x".repeat(100)).slice(1)') == u'caf\xe9' + 'x' * 100
+    # lone surrogates survive both ways instead of failing to decode
+    assert context.eval('"a\\ud800b"') == u'a\ud800b'
+    assert context.eval('"\\udc00" + "\\ud83d\\ude00"') == u'\udc00\U0001f600'
+    context.string = u'\ud800' + u'\U0001f600' * 10
+    assert context.eval('string.charCodeAt(0)') == 0xd800
+    assert context.eval('string.length') == 21
+
+def test_external_strings(context):
+    set_external_string_threshold(16)
+    try:
+        string = 'shared with javascript ' * 10
+        refs = sys.getrefcount(string)
+        context.string = string
+        # the external string holds a reference instead of a copy
+        assert sys.getrefcount(string) > refs
+        assert context.eval('string') == string
+        assert context.eval('string.length') == len(string)
+        assert context.eval('string.slice(0, 6) + string.toUpperCase().slice(-11)') == 'sharedJAVASCRIPT '
+        latin1 = u'caf\xe9 ' * 10
+        context.latin1 = latin1
+        assert context.eval('latin1') == latin1
+        two_byte = u'\u20ac\u4e2d ' * 10
+        context.two_byte = two_byte
+        assert context.eval('two_byte') == two_byte
+        assert context.eval('two_byte.charCodeAt(0)') == 0x20ac
+        # short strings are still copied
+        context.short = u'short'
+        assert context.eval('short') == u'short'
+    finally:
+        set_external_string_threshold(64 * 1024)
+
+def test_buffers(context):
+    context.eval('function text(buffer) { return String.fromCharCode.apply(null, new Uint8Array(buffer)); }')
+    if sys.version_info >= (3,):
+        assert context.text(b'bytes') == 'bytes'
+        # bytes are immutable, so JavaScript gets a copy
+        immutable = b'immutable'
+        context.immutable = immutable
+        context.eval('new Uint8Array(immutable)[0] = 73')
+        assert immutable == b'immutable'
+        assert context.eval('new Uint8Array(immutable)[0]') == 73
+    data = bytearray(b'shared')
+    context.data = data
+    assert context.eval('data instanceof ArrayBuffer')
+    assert context.eval('text(data)') == 'shared'
+    # JavaScript sees the bytearray's own memory
+    context.eval('new Uint8Array(data)[0] = 83')
+    assert data == bytearray(b'Shared')
+    data[1] = ord('H')
+    assert context.eval('text(data)') == 'SHared'
+
+    context.copy = BufferCopy(data)
+    context.eval('new Uint8Array(copy)[0] = 115')
+    assert data == bytearray(b'SHared')
+    assert context.text(BufferCopy(data)) == 'SHared'
+
+    if sys.version_info >= (3,):
+        # not contiguous, so it gets copied
+        assert context.text(memoryview(b'abcdef')[::2]) == 'ace'
+    assert context.eval('(function (a) { return a.byteLength; })')(array.array('i', [1, 2, 3])) == 12
+    assert context.eval('(function (a) { return new Int32Array(a)[2]; })')(array.array('i', [1, 2, 3])) == 3
+
+def test_js_buffers(context):
+    floats = context.eval('floats = new Float64Array([1.5, 2.5, 3.5])')
+    assert isinstance(floats, JSBuffer)
+    assert floats.length == 3
+    view = memoryview(floats)
+    assert view.format == 'd'
+    assert view.shape == (3,)
+    assert view.tolist() == [1.5, 2.5, 3.5]
+    # the view is the JavaScript memory, not a copy
+    view[0] = 9.5
+    assert context.eval('floats[0]') == 9.5
+    context.eval('floats[2] = -1')
+    assert view[2] == -1
+    view.release()
+    # passing it back passes the same typed array
+    context.back = floats
+    assert context.eval('back === floats && back instanceof Float64Array')
+    context.back = context.eval('floats.buffer')
+    assert context.eval('back === floats.buffer')
+
+    ints = memoryview(context.eval('new Int32Array([1, -2, 3]).subarray(1)'))
+    assert (ints.format, ints.shape, ints.tolist()) == ('i', (2,), [-2, 3])
+    assert memoryview(context.eval('new Uint8Array([1, 2, 255])')).tolist() == [1, 2, 255]
+    assert memoryview(context.eval('new Float32Array(4)')).nbytes == 16
+    raw = memoryview(context.eval('new Uint16Array([0x4241, 0x4443]).buffer'))
+    assert (raw.format, raw.tobytes()) == ('B', b'ABCD')
+
+def test_js_buffer_outlives_object(context):
+    assert JSBuffer.__name__ == 'JSBuffer'
+    view = memoryview(context.eval('new Uint8Array([1, 2, 3])'))
+    # the exported memory is taken over, so it's still there after the
+    # JavaScript side is collected
+    context.eval('for (let i = 0; i < 1000; i++) new ArrayBuffer(1024 * 1024); gc()')
+    view[0] = 4
+    assert view.tolist() == [4, 2, 3]
+    view.release()
+
+def test_array_fast_paths(context):
+    numbers = list(range(5000)) + [0.5, -1, 2 ** 31, u'str', None]
+    context.numbers = numbers
+    assert context.eval('numbers.length') == len(numbers)
+    assert context.eval('numbers[4999] + numbers[5000]') == 4999.5
+    assert context.eval('numbers') == numbers
+    assert context.eval('Array.from({length: 3000}, (x, i) => i * 0.5)') == [i * 0.5 for i in range(3000)]
+    assert context.eval('[true, [1, "two"], {three: 3}]') == [True, [1, 'two'], {'three': 3}]
+    context.big = 2 ** 40
+    assert context.eval('big === Math.pow(2, 40)')
+
+def test_dict_shapes(context):
+    records = [{'id': i, 'name': 'item %d' % i, 'price': i * 0.5} for i in range(100)]
+    context.records = records
+    assert context.eval('records') == records
+    assert context.eval('Object.keys(records[5]).join()') == 'id,name,price'
+    # objects built from the same shape are still separate objects
+    context.eval('records[0].name = "changed"; records[0].extra = true')
+    assert context.eval('records[1].name') == 'item 1'
+    assert context.eval('"extra" in records[1]') is False
+    # keys that can't share a shape still work
+    context.odd = {'1': 'one', '__proto__': None, '': 'empty', 'x': 2}
+    assert context.eval('odd[1]') == 'one'
+    assert context.eval('odd[""]') == 'empty'
+    assert context.eval('odd.x') == 2
+
+def test_object_keys_shared(context):
+    records = context.eval('Array.from({length: 1000}, (x, i) => ({id: i, name: "n" + i}))')
+    assert records[999] == {'id': 999, 'name': 'n999'}
+    if sys.version_info >= (3,):
+        first, last = list(records[0]), list(records[999])
+        assert all(a is b for a, b in zip(first, last))
+    # inherited properties aren't own properties and don't get copied
+    assert context.eval('Object.prototype.inherited = 1; ({own: 2})') == {'own': 2}
+    context.eval('delete Object.prototype.inherited')
+    assert context.eval('({1: "one", 2: "two"})') == {1: 'one', 2: 'two'}
+
+def test_convert_policies(context):
+    source = '({list: [1, {two: 2}], obj: {three: [3]}})'
+    assert context.convert == 'deep'
+    shallow = context.eval(source, convert='shallow')
+    assert sorted(shallow) == ['list', 'obj']
+    assert isinstance(shallow['list'], JSObject)
+    assert shallow['list'][1] == {'two': 2}
+
+    proxy = context.eval(source, convert='proxy')
+    assert isinstance(proxy, JSMapping)
+    assert len(proxy) == 2 and 'obj' in proxy and 'nope' not in proxy
+    assert isinstance(proxy['list'], JSSequence)
+    assert (JSMapping.__name__, JSSequence.__name__) == ('JSMapping', 'JSSequence')
+    assert proxy['list'][-1]['two'] == 2
+    assert proxy['list'][:1] == [1]
+    assert proxy == {'list': [1, {'two': 2}], 'obj': {'three': [3]}}
+    assert proxy.get('nope', 5) == 5
+    with pytest.raises(KeyError):
+        proxy['nope']
+    with pytest.raises(IndexError):
+        proxy['list'][2]
+
+    # views write through, and go back to JavaScript as the original object
+    proxy['obj']['three'][0] = 4
+    proxy['added'] = True
+    context.result = proxy
+    assert context.eval('result.obj.three[0] === 4 && result.added')
+
+    context.convert = 'proxy'
+    assert isinstance(context.eval('[1, 2]'), JSSequence)
+    f = context.eval('(function () { return {a: [1]}; })')
+    assert isinstance(f(), JSMapping)
+    assert f(convert='deep') == {'a': [1]}
+    with pytest.raises(ValueError):
+        Context(convert='lazy')
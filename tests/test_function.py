@@ -1,5 +1,5 @@
 import pytest
-from v8py import JSFunction, JSObject, new
+from v8py import JSFunction, JSObject, JSException, new
 
 def test_function(context):
     def len_args(*args):
@@ -68,3 +68,16 @@ def test_new_keyword(context):
     instance = new(context.glob.MoreThan16Arguments, *args)
     assert instance.data == args
     assert context.glob.MoreThan16Arguments2(*args) == args
+
+def test_compile_function(context):
+    context.prefix = '> '
+    render = context.compile_function('return prefix + name + "!" + extra', params=['name', 'extra'])
+    assert render('kappa', '') == '> kappa!'
+    assert render('pride', '?') == '> pride!?'
+
+def test_compile_function_no_params(context):
+    assert context.compile_function('return 42')() == 42
+
+def test_compile_function_syntax_error(context):
+    with pytest.raises(JSException):
+        context.compile_function('return (', params=['x'])
@@ -0,0 +1,66 @@
+import pytest
+import threading
+from v8py import Context, Script, Isolate, IsolatePool, default_isolate
+
+def test_default_isolate(context):
+    assert context.isolate is default_isolate
+
+def test_explicit_isolate():
+    isolate = Isolate()
+    context = Context(isolate=isolate)
+    assert context.isolate is isolate
+    assert isolate.contexts == 1
+    context.foo = 'bar'
+    assert context.eval('foo') == 'bar'
+    del context
+    assert isolate.contexts == 0
+
+def test_round_robin():
+    pool = IsolatePool(size=3)
+    assert len(pool) == 3
+    contexts = [Context(isolate=pool) for i in range(6)]
+    assert [c.isolate for c in contexts] == [pool[0], pool[1], pool[2]] * 2
+
+def test_least_loaded():
+    pool = IsolatePool(size=2, placement='least_loaded')
+    c1 = Context(isolate=pool)
+    c2 = Context(isolate=pool)
+    assert c1.isolate is not c2.isolate
+    del c1
+    c3 = Context(isolate=pool)
+    assert c3.isolate is not c2.isolate
+
+def test_bad_placement():
+    with pytest.raises(ValueError):
+        IsolatePool(placement='random')
+
+def test_script_isolate():
+    isolate = Isolate()
+    context = Context(isolate=isolate)
+    context.kappa = 'pride'
+    assert context.eval(Script('kappa', isolate=isolate)) == 'pride'
+    with pytest.raises(ValueError):
+        context.eval(Script('kappa'))
+
+def test_exposed_across_isolates():
+    class Test(object):
+        def get(self): return 'got'
+    c1 = Context(isolate=Isolate())
+    c2 = Context(isolate=Isolate())
+    c1.expose(Test)
+    c2.expose(Test)
+    assert c1.eval('new Test().get()') == 'got'
+    assert c2.eval('new Test().get()') == 'got'
+
+def test_threads():
+    pool = IsolatePool(size=2)
+    results = {}
+    def run(i):
+        context = Context(isolate=pool[i])
+        results[i] = context.eval('var x = 0; for (var j = 0; j < 1000; j++) x += j; x')
+    threads = [threading.Thread(target=run, args=(i,)) for i in range(2)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    assert results == {0: 499500, 1: 499500}
@@ -0,0 +1,56 @@
+import pytest
+from v8py import JSException, live
+
+def test_live_dict(context):
+    data = {'a': 1, 'nested': {'b': [1, 2]}}
+    context.data = live(data)
+    assert context.eval('data.a') == 1
+    assert context.eval('data.missing') is None
+    assert context.eval('Object.keys(data).sort().join()') == 'a,nested'
+    assert context.eval('"a" in data && !("b" in data)')
+    # keys aren't hidden by the dict's own methods
+    data['keys'] = 'not a method'
+    assert context.eval('data.keys') == 'not a method'
+
+    context.eval('data.a = 2; data.nested.b[0] = 3; data.added = [4]; delete data.keys')
+    assert data == {'a': 2, 'nested': {'b': [3, 2]}, 'added': [4]}
+    assert context.eval('data') is data
+
+def test_live_list(context):
+    items = [1, 2, 3]
+    context.items = live(items)
+    assert context.eval('items.length') == 3
+    assert context.eval('items.map(x => x * 2)') == [2, 4, 6]
+    assert context.eval('items.indexOf(2)') == 1
+    context.eval('items.push(4); items[0] = 0')
+    assert items == [0, 2, 3, 4]
+    assert context.eval('items.pop()') == 4
+    assert items == [0, 2, 3]
+    context.eval('items.length = 1')
+    assert items == [0]
+    assert context.eval('items[5]') is None
+    context.eval('items.length = 3')
+    assert items == [0, None, None]
+    with pytest.raises(JSException):
+        context.eval('items.length = 4294967295')
+    assert len(items) == 3
+
+def test_live_type(context):
+    with pytest.raises(TypeError):
+        live(1)
+
+def test_live_delete_missing(context):
+    data = {'a': 1}
+    context.data = live(data)
+    assert context.eval('delete data.missing')
+    assert context.eval('"use strict"; delete data.missing')
+    assert context.eval('delete data.a; Object.keys(data).length') == 0
+    assert data == {}
+
+def test_live_identity(context):
+    data = {'nested': {'b': 1}, 'items': [[1]]}
+    context.data = live(data)
+    context.again = live(data)
+    assert context.eval('data === again')
+    assert context.eval('data.nested === data.nested')
+    assert context.eval('data.items[0] === data.items[0]')
@@ -29,3 +29,15 @@ def test_str(obj):
 def test_jsobject(context):
     f = context.eval('Math.sqrt')
     assert isinstance(f, JSObject)
+
+def test_many_names(obj):
+    # more names than the name cache has slots, so some share one
+    for i in range(3000):
+        setattr(obj, 'name%d' % i, i)
+    for i in range(3000):
+        assert getattr(obj, 'name%d' % i) == i
+    obj[u'caf\xe9'] = 1
+    assert obj[u'caf\xe9'] == 1
+    del obj.name5
+    assert not hasattr(obj, 'name5')
+    assert obj.name6 == 6
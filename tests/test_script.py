@@ -1,5 +1,8 @@
+import io
 import pytest
-from v8py import Context, Script, JSException
+import warnings
+import weakref
+from v8py import Context, Script, Isolate, JSException, set_code_cache_dir
 
 def test_script():
     c1 = Context()
@@ -16,3 +19,163 @@ def test_identical_scripts():
 def test_filename():
     s = Script('kappa', filename='file')
     # why bother testing more...
+
+def test_code_cache():
+    source = 'function cached() { return "kappa"; } cached()'
+    cache = Script(source, code_cache=True).code_cache
+    assert isinstance(cache, bytes)
+    isolate = Isolate()
+    s = Script(source, isolate=isolate, code_cache=cache)
+    assert not s.code_cache_rejected
+    assert Context(isolate=isolate).eval(s) == 'kappa'
+
+def test_code_cache_reused():
+    # compiled once in this isolate, so on V8 that can't make a cache after
+    # the fact the cache has to come from that compile
+    source = 'function reused() { return "reused"; } reused()'
+    s = Script(source, code_cache=True)
+    Context().eval(s)
+    cache = s.code_cache
+    assert isinstance(cache, bytes) and len(cache) > 0
+    isolate = Isolate()
+    again = Script(source, isolate=isolate, code_cache=cache)
+    assert not again.code_cache_rejected
+    assert Context(isolate=isolate).eval(again) == 'reused'
+
+def test_code_cache_dir_rejected(tmpdir):
+    set_code_cache_dir(str(tmpdir))
+    try:
+        Script('"truncated"', isolate=Isolate())
+        path, = tmpdir.listdir()
+        path.write_binary(path.read_binary()[:10])
+        s = Script('"truncated"', isolate=Isolate())
+        assert s.code_cache_rejected
+        # replaced, or removed so the next start writes a good one
+        for path in tmpdir.listdir():
+            assert len(path.read_binary()) > 10
+        assert not [p for p in tmpdir.listdir() if p.ext == '.tmp']
+    finally:
+        set_code_cache_dir(None)
+
+def test_code_cache_rejected():
+    s = Script('"rejected"', code_cache=b'garbage')
+    assert s.code_cache_rejected
+    assert Context().eval(s) == 'rejected'
+
+def test_code_cache_dir(tmpdir):
+    set_code_cache_dir(str(tmpdir))
+    try:
+        Script('"on disk"', isolate=Isolate())
+        assert len(tmpdir.listdir()) == 1
+        isolate = Isolate()
+        s = Script('"on disk"', isolate=isolate)
+        assert not s.code_cache_rejected
+        assert Context(isolate=isolate).eval(s) == 'on disk'
+        # eval doesn't leave caches behind
+        Context().eval('"not on disk"')
+        assert len(tmpdir.listdir()) == 1
+    finally:
+        set_code_cache_dir(None)
+
+def test_compile_cache():
+    c = Context()
+    for i in range(3):
+        assert c.eval('1 + 1') == 2
+    assert c.compile_cache_misses == 1
+    assert c.compile_cache_hits == 2
+    c.eval('1 + 1', filename='other')
+    assert c.compile_cache_misses == 2
+
+def test_compile_cache_bounded():
+    c = Context(compile_cache_size=2)
+    c.eval('1')
+    c.eval('2')
+    c.eval('1')
+    c.eval('3')  # evicts '2'
+    c.eval('1')
+    assert c.compile_cache_hits == 2
+    c.eval('2')
+    assert c.compile_cache_misses == 4
+    c.compile_cache_size = 0
+    c.eval('1')
+    assert c.compile_cache_misses == 4
+
+def test_script_retention():
+    c = Context(script_retention=2, compile_cache_size=0)
+    assert c.script_retention == 2
+    scripts = [Script('"retained %d"' % i) for i in range(3)]
+    refs = [weakref.ref(s) for s in scripts]
+    for s in scripts:
+        c.eval(s)
+    del scripts, s
+    assert [r() is not None for r in refs] == [False, True, True]
+
+def test_script_retention_referenced():
+    c = Context(script_retention='referenced', compile_cache_size=0)
+    s = Script('"referenced"')
+    ref = weakref.ref(s)
+    assert c.eval(s) == 'referenced'
+    del s
+    assert ref() is None
+    c.script_retention = 'all'
+    assert c.script_retention == 'all'
+    with pytest.raises(ValueError):
+        c.script_retention = 'some'
+
+def test_eval_with_debugger():
+    from v8py.debug import PlainDebugger
+    c = Context()
+    debugger = PlainDebugger(c)
+    s = Script('var count = (this.count || 0) + 1; count')
+    assert c.eval(s) == 1
+    assert c.eval(s) == 2
+
+def test_compile_async():
+    script = Script.compile_async('"streamed " + "kappa"').result(timeout=10)
+    assert Context().eval(script) == 'streamed kappa'
+
+def test_compile_async_file(tmpdir):
+    path = tmpdir.join('big.js')
+    path.write('var total = 0;\n' + 'total += 1;\n' * 20000 + 'total')
+    script = Script.compile_async(path.open('rb')).result(timeout=10)
+    assert Context().eval(script) == 20000
+
+def test_compile_async_unnamed_file():
+    # BytesIO has no name to use as the filename
+    for i in range(100):
+        script = Script.compile_async(io.BytesIO(b'"no name"')).result(timeout=10)
+        assert Context().eval(script) == 'no name'
+
+def test_compile_async_error():
+    with pytest.raises(JSException):
+        Script.compile_async('this is not javascript').result(timeout=10)
+
+def test_compile_many():
+    sources = ['"tenant %d"' % i for i in range(20)] + [('this is broken', 'broken.js')]
+    results = Script.compile_many(sources, workers=4)
+    assert len(results) == 21
+    c = Context()
+    for i, result in enumerate(results[:20]):
+        assert result.error is None
+        assert result.compile_time >= 0
+        assert c.eval(result.script) == 'tenant %d' % i
+    assert results[20].script is None
+    assert isinstance(results[20].error, JSException)
+
+def test_eager():
+    with warnings.catch_warnings(record=True) as caught:
+        warnings.simplefilter('always')
+        s = Script('function hot() { return "eager"; } hot()', eager=True, code_cache=True)
+    assert Context().eval(s) == 'eager'
+    assert isinstance(s.code_cache, bytes)
+    if not s.eager:
+        assert [w.category for w in caught] == [RuntimeWarning]
+        pytest.skip('this V8 has no eager compilation')
+    assert not caught
+
+    # functions nobody called are compiled, so their code ends up in the cache
+    body = ' '.join('x = x * %d + 1;' % i for i in range(400))
+    lazy = Script('function lazy(x) { %s return x; } "lazy"' % body, code_cache=True)
+    eager = Script('function eager(x) { %s return x; } "eager"' % body, eager=True, code_cache=True)
+    assert eager.eager and not lazy.eager
+    assert len(eager.code_cache) > len(lazy.code_cache) + 1000
@@ -0,0 +1,40 @@
+import pytest
+from v8py import Context, Isolate, Snapshot
+
+SETUP = 'var greeting = "hello"; function greet(name) { return greeting + " " + name; }'
+
+def test_snapshot():
+    snapshot = Snapshot(SETUP)
+    context = Context(snapshot=snapshot)
+    assert context.eval('greet("world")') == 'hello world'
+    assert context.isolate.has_snapshot
+
+def test_snapshot_contexts_are_separate():
+    snapshot = Snapshot(SETUP)
+    c1 = Context(snapshot=snapshot)
+    c2 = Context(snapshot=snapshot)
+    c1.eval('greeting = "bye"')
+    assert c2.eval('greet("world")') == 'hello world'
+
+def test_snapshot_blob():
+    blob = Snapshot(SETUP).blob
+    assert isinstance(blob, bytes)
+    context = Context(snapshot=Snapshot(blob=blob))
+    assert context.eval('greet("again")') == 'hello again'
+
+def test_snapshot_isolate():
+    snapshot = Snapshot(SETUP)
+    isolate = Isolate(snapshot=snapshot)
+    context = Context(snapshot=snapshot, isolate=isolate)
+    assert context.eval('greeting') == 'hello'
+    with pytest.raises(ValueError):
+        Context(snapshot=snapshot, isolate=Isolate())
+
+def test_snapshot_python_in_snapshot_context():
+    context = Context(snapshot=Snapshot(SETUP))
+    context.name = 'python'
+    assert context.eval('greet(name)') == 'hello python'
+
+def test_snapshot_error():
+    with pytest.raises(ValueError):
+        Snapshot('throw new Error("nope")')
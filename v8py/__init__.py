@@ -1,5 +1,12 @@
 from _v8py import *
 
+try:
+    from collections.abc import Mapping, Sequence
+except ImportError:
+    from collections import Mapping, Sequence
+Mapping.register(JSMapping)
+Sequence.register(JSSequence)
+
 from .debug import Debugger, DebuggerError
 try:
     from gevent import monkey;monkey.patch_all()
@@ -0,0 +1,269 @@
+#include <Python.h>
+#include "v8py.h"
+#include <v8.h>
+
+#include "buffer.h"
+#include "jsobject.h"
+
+using namespace v8;
+
+PyTypeObject buffer_copy_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+int buffer_copy_type_init() {
+    buffer_copy_type.tp_name = "v8py.BufferCopy";
+    buffer_copy_type.tp_basicsize = sizeof(buffer_copy_c);
+    buffer_copy_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    buffer_copy_type.tp_doc = "Wraps a buffer so it's copied into JavaScript instead of shared";
+    buffer_copy_type.tp_new = (newfunc) buffer_copy_new;
+    buffer_copy_type.tp_dealloc = (destructor) buffer_copy_dealloc;
+    return PyType_Ready(&buffer_copy_type);
+}
+
+PyObject *buffer_copy_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    PyObject *object;
+    static const char *keywords[] = {"object", NULL};
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char **) keywords, &object) < 0) {
+        return NULL;
+    }
+    if (!PyObject_CheckBuffer(object)) {
+        PyErr_SetString(PyExc_TypeError, "BufferCopy needs an object that supports the buffer protocol");
+        return NULL;
+    }
+    buffer_copy_c *self = (buffer_copy_c *) type->tp_alloc(type, 0);
+    PyErr_PROPAGATE(self);
+    Py_INCREF(object);
+    self->object = object;
+    return (PyObject *) self;
+}
+
+void buffer_copy_dealloc(buffer_copy_c *self) {
+    Py_DECREF(self->object);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+// Owns an exported Py_buffer for as long as the ArrayBuffer over it lives
+struct py_buffer_handle {
+    Py_buffer view;
+    Persistent<ArrayBuffer> array_buffer;
+};
+
+static void py_buffer_weak_callback(const WeakCallbackInfo<py_buffer_handle> &info) {
+    WITH_GIL;
+    py_buffer_handle *handle = info.GetParameter();
+    handle->array_buffer.Reset();
+    info.GetIsolate()->AdjustAmountOfExternalAllocatedMemory(-(int64_t) handle->view.len);
+    PyBuffer_Release(&handle->view);
+    delete handle;
+}
+
+Local<ArrayBuffer> js_array_buffer_from_py(PyObject *value, bool copy, Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
+    EscapableHandleScope hs(isolate);
+
+    py_buffer_handle *handle = new py_buffer_handle();
+    if (PyObject_GetBuffer(value, &handle->view, PyBUF_FULL_RO) < 0) {
+        PyErr_Clear();
+        delete handle;
+        return Local<ArrayBuffer>();
+    }
+    Py_buffer *view = &handle->view;
+
+    // read-only memory (bytes, and anything interned or shared with it)
+    // mustn't end up writable from JavaScript
+    if (copy || view->readonly || !PyBuffer_IsContiguous(view, 'C')) {
+        Local<ArrayBuffer> array_buffer = ArrayBuffer::New(isolate, view->len);
+        PyBuffer_ToContiguous(array_buffer->GetContents().Data(), view, view->len, 'C');
+        PyBuffer_Release(view);
+        delete handle;
+        return hs.Escape(array_buffer);
+    }
+
+    Local<ArrayBuffer> array_buffer = ArrayBuffer::New(isolate, view->buf, view->len,
+            ArrayBufferCreationMode::kExternalized);
+    handle->array_buffer.Reset(isolate, array_buffer);
+    handle->array_buffer.SetWeak(handle, py_buffer_weak_callback, WeakCallbackType::kFinalizer);
+    // so a big buffer nudges V8 into collecting it and letting the export go
+    isolate->AdjustAmountOfExternalAllocatedMemory(view->len);
+    return hs.Escape(array_buffer);
+}
+
+PyBufferProcs js_buffer_buffer_procs;
+PyTypeObject js_buffer_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+int js_buffer_type_init() {
+    js_buffer_buffer_procs.bf_getbuffer = (getbufferproc) js_buffer_getbuffer;
+    js_buffer_buffer_procs.bf_releasebuffer = (releasebufferproc) js_buffer_releasebuffer;
+
+    js_buffer_type.tp_name = "v8py.JSBuffer";
+    js_buffer_type.tp_basicsize = sizeof(js_buffer);
+    js_buffer_type.tp_dealloc = (destructor) js_buffer_dealloc;
+    js_buffer_type.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER;
+    js_buffer_type.tp_doc = "";
+    js_buffer_type.tp_as_buffer = &js_buffer_buffer_procs;
+    js_buffer_type.tp_base = &js_object_type;
+    return PyType_Ready(&js_buffer_type);
+}
+
+bool js_object_is_buffer(Local<Object> object) {
+    return object->IsArrayBuffer() || object->IsSharedArrayBuffer() || object->IsArrayBufferView();
+}
+
+void js_buffer_dealloc(js_buffer *self) {
+    // views hold a reference, so there can't be any left
+    if (self->py_isolate != NULL) {
+        IsolateLocker locker(self->py_isolate->isolate);
+        self->pinned.Reset();
+    }
+    js_object_dealloc((js_object *) self);
+}
+
+// struct module format of the elements, and their size
+static const char *js_buffer_format(Local<Object> object, Py_ssize_t *itemsize) {
+    struct { bool matches; const char *format; Py_ssize_t itemsize; } formats[] = {
+        {object->IsInt8Array(), "b", 1},
+        {object->IsInt16Array(), "h", 2},
+        {object->IsUint16Array(), "H", 2},
+        {object->IsInt32Array(), "i", 4},
+        {object->IsUint32Array(), "I", 4},
+        {object->IsFloat32Array(), "f", 4},
+        {object->IsFloat64Array(), "d", 8},
+#if V8_MAJOR_VERSION > 6 || (V8_MAJOR_VERSION == 6 && V8_MINOR_VERSION >= 7)
+        {object->IsBigInt64Array(), "q", 8},
+        {object->IsBigUint64Array(), "Q", 8},
+#endif
+    };
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        if (formats[i].matches) {
+            *itemsize = formats[i].itemsize;
+            return formats[i].format;
+        }
+    }
+    // bytes for everything else: Uint8Array, Uint8ClampedArray, DataView,
+    // and the buffers themselves
+    *itemsize = 1;
+    return "B";
+}
+
+// Memory taken over from V8 by externalizing an ArrayBuffer, so a view of
+// it stays valid even if the ArrayBuffer is neutered. It's freed once the
+// ArrayBuffer is collected and every view has been released.
+struct js_buffer_store {
+    void *data;
+    size_t length;
+    int refs;
+    Persistent<ArrayBuffer> array_buffer;
+};
+
+static void js_buffer_store_release(js_buffer_store *store) {
+    if (--store->refs == 0) {
+        array_buffer_allocator->Free(store->data, store->length);
+        delete store;
+    }
+}
+
+static void js_buffer_store_weak_callback(const WeakCallbackInfo<js_buffer_store> &info) {
+    WITH_GIL;
+    js_buffer_store *store = info.GetParameter();
+    store->array_buffer.Reset();
+    info.GetIsolate()->AdjustAmountOfExternalAllocatedMemory(-(int64_t) store->length);
+    js_buffer_store_release(store);
+}
+
+// The store for the ArrayBuffer with a reference for the caller, making one
+// the first time. NULL if the memory was already externalized by somebody
+// else, who owns it and won't free it while the pinned ArrayBuffer is alive.
+static js_buffer_store *js_buffer_store_for(Local<ArrayBuffer> array_buffer, Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
+    Local<Private> key = Private::ForApi(isolate, JSTR("v8py::buffer_store"));
+    Local<Value> existing;
+    if (array_buffer->GetPrivate(context, key).ToLocal(&existing) && existing->IsExternal()) {
+        js_buffer_store *store = (js_buffer_store *) existing.As<External>()->Value();
+        store->refs++;
+        return store;
+    }
+    if (array_buffer->IsExternal()) {
+        return NULL;
+    }
+
+    ArrayBuffer::Contents contents = array_buffer->Externalize();
+    js_buffer_store *store = new js_buffer_store();
+    store->data = contents.Data();
+    store->length = contents.ByteLength();
+    // one for the ArrayBuffer, one for the caller
+    store->refs = 2;
+    store->array_buffer.Reset(isolate, array_buffer);
+    store->array_buffer.SetWeak(store, js_buffer_store_weak_callback, WeakCallbackType::kFinalizer);
+    array_buffer->SetPrivate(context, key, External::New(isolate, store)).FromJust();
+    isolate->AdjustAmountOfExternalAllocatedMemory(store->length);
+    return store;
+}
+
+int js_buffer_getbuffer(js_buffer *self, Py_buffer *view, int flags) {
+    IN_V8(self->py_isolate->isolate);
+    Local<Object> object = self->object.Get(isolate);
+    if (object.IsEmpty()) {
+        PyErr_SetString(PyExc_BufferError, "the JavaScript object is gone");
+        view->obj = NULL;
+        return -1;
+    }
+    Local<Context> context = object->CreationContext();
+
+    // SharedArrayBuffers can't be neutered, ArrayBuffers have to be
+    // externalized so the memory outlives neutering
+    js_buffer_store *store = NULL;
+    if (object->IsArrayBufferView()) {
+        store = js_buffer_store_for(object.As<ArrayBufferView>()->Buffer(), context);
+    } else if (object->IsArrayBuffer()) {
+        store = js_buffer_store_for(object.As<ArrayBuffer>(), context);
+    }
+
+    char *data;
+    Py_ssize_t length;
+    if (object->IsArrayBufferView()) {
+        Local<ArrayBufferView> array_view = object.As<ArrayBufferView>();
+        data = (char *) array_view->Buffer()->GetContents().Data() + array_view->ByteOffset();
+        length = array_view->ByteLength();
+    } else if (object->IsSharedArrayBuffer()) {
+        SharedArrayBuffer::Contents contents = object.As<SharedArrayBuffer>()->GetContents();
+        data = (char *) contents.Data();
+        length = contents.ByteLength();
+    } else {
+        ArrayBuffer::Contents contents = object.As<ArrayBuffer>()->GetContents();
+        data = (char *) contents.Data();
+        length = contents.ByteLength();
+    }
+    Py_ssize_t itemsize;
+    const char *format = js_buffer_format(object, &itemsize);
+
+    if (self->exports++ == 0) {
+        self->pinned.Reset(isolate, object);
+    }
+    self->shape = length / itemsize;
+    self->stride = itemsize;
+
+    Py_INCREF(self);
+    view->obj = (PyObject *) self;
+    view->buf = data;
+    view->len = length;
+    view->readonly = 0;
+    view->itemsize = itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (char *) format : NULL;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) ? &self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &self->stride : NULL;
+    view->suboffsets = NULL;
+    view->internal = store;
+    return 0;
+}
+
+void js_buffer_releasebuffer(js_buffer *self, Py_buffer *view) {
+    if (view->internal != NULL) {
+        js_buffer_store_release((js_buffer_store *) view->internal);
+    }
+    if (--self->exports == 0) {
+        IsolateLocker locker(self->py_isolate->isolate);
+        self->pinned.Reset();
+    }
+}
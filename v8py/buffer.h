@@ -0,0 +1,56 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <Python.h>
+#include <v8.h>
+
+#include "isolate.h"
+
+using namespace v8;
+
+// Objects with the buffer protocol (bytearray, writable memoryviews, mmap,
+// array.array...) go to JavaScript as an ArrayBuffer over the object's own
+// memory. The buffer stays exported, so a bytearray can't be resized, until
+// V8 collects the ArrayBuffer.
+//
+// BufferCopy(obj) asks for a copy instead, which JavaScript owns outright.
+// Read-only buffers (bytes) and buffers that aren't C-contiguous get copied
+// either way, since JavaScript could write to an ArrayBuffer.
+typedef struct {
+    PyObject_HEAD
+    PyObject *object;
+} buffer_copy_c;
+extern PyTypeObject buffer_copy_type;
+int buffer_copy_type_init();
+
+PyObject *buffer_copy_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void buffer_copy_dealloc(buffer_copy_c *self);
+
+// Empty if the object won't export a buffer after all, with the Python
+// exception cleared
+Local<ArrayBuffer> js_array_buffer_from_py(PyObject *value, bool copy, Local<Context> context);
+
+// ArrayBuffers, SharedArrayBuffers, typed arrays and DataViews come back to
+// Python as a JSBuffer, which is a JSObject that also has the buffer
+// protocol, so memoryview(buffer) reads the memory in place with the typed
+// array's format and length. While any view is exported, the JSBuffer holds
+// the JavaScript object strongly so its memory can't be collected.
+typedef struct {
+    PyObject_HEAD
+    Persistent<Object> object;
+    isolate_c *py_isolate;
+    // set while there are exported views
+    Persistent<Object> pinned;
+    Py_ssize_t exports;
+    Py_ssize_t shape;
+    Py_ssize_t stride;
+} js_buffer;
+extern PyTypeObject js_buffer_type;
+int js_buffer_type_init();
+
+bool js_object_is_buffer(Local<Object> object);
+void js_buffer_dealloc(js_buffer *self);
+int js_buffer_getbuffer(js_buffer *self, Py_buffer *view, int flags);
+void js_buffer_releasebuffer(js_buffer *self, Py_buffer *view);
+
+#endif
@@ -2,27 +2,20 @@
 #include "v8py.h"
 #include <v8.h>
 
-#ifdef _WIN32
-#include <Windows.h>
-#else
-#include <pthread.h>
-#endif
-
 #include "context.h"
 #include "script.h"
 #include "convert.h"
 #include "jsobject.h"
 #include "pyclass.h"
+#include "snapshot.h"
 
 using namespace v8;
 
-static void js_promise_fulfilled_callback(const FunctionCallbackInfo<Value> &info);
-static void js_promise_rejected_callback(const FunctionCallbackInfo<Value> &info);
-
 PyMethodDef context_methods[] = {
     {"eval", (PyCFunction) context_eval, METH_VARARGS | METH_KEYWORDS, NULL},
     {"async_call", (PyCFunction) context_async_call, METH_VARARGS | METH_KEYWORDS, NULL},
     {"bind", (PyCFunction) context_bind_py_function, METH_VARARGS, NULL},
+    {"compile_function", (PyCFunction) context_compile_function, METH_VARARGS | METH_KEYWORDS, NULL},
     {"expose", (PyCFunction) context_expose, METH_VARARGS | METH_KEYWORDS, NULL},
     {"expose_module", (PyCFunction) context_expose_module, METH_O, NULL},
     {"gc", (PyCFunction) context_gc, METH_NOARGS, NULL},
@@ -31,7 +24,17 @@ PyMethodDef context_methods[] = {
 // Python is wrong. The first entry is not modifiable and should be const char *
 PyGetSetDef context_getset[] = {
     {(char *) "glob", (getter) context_get_global, NULL, NULL, NULL},
+    {(char *) "isolate", (getter) context_get_isolate, NULL, NULL, NULL},
     {(char *) "timeout", (getter) context_get_timeout, (setter) context_set_timeout, NULL, NULL},
+    {(char *) "cpu_timeout", (getter) context_get_cpu_timeout, (setter) context_set_cpu_timeout, NULL, NULL},
+    {(char *) "last_cpu_time", (getter) context_get_last_cpu_time, NULL, NULL, NULL},
+    {(char *) "cpu_time", (getter) context_get_cpu_time, NULL, NULL, NULL},
+    {(char *) "script_retention", (getter) context_get_script_retention, (setter) context_set_script_retention, NULL, NULL},
+    {(char *) "compile_cache_size", (getter) context_get_compile_cache_size, (setter) context_set_compile_cache_size, NULL, NULL},
+    {(char *) "compile_cache_hits", (getter) context_get_compile_cache_hits, NULL, NULL, NULL},
+    {(char *) "compile_cache_misses", (getter) context_get_compile_cache_misses, NULL, NULL, NULL},
+    {(char *) "release_gil", (getter) context_get_release_gil, (setter) context_set_release_gil, NULL, NULL},
+    {(char *) "convert", (getter) context_get_convert, (setter) context_set_convert, NULL, NULL},
     {NULL},
 };
 PyMappingMethods context_mapping = {
@@ -40,7 +43,14 @@ PyMappingMethods context_mapping = {
 PyTypeObject context_type = {
     PyVarObject_HEAD_INIT(NULL, 0)
 };
+static PyObject *ordered_dict;
 int context_type_init() {
+    PyObject *collections_module = PyImport_ImportModule("collections");
+    PyErr_PROPAGATE_(collections_module);
+    ordered_dict = PyObject_GetAttrString(collections_module, "OrderedDict");
+    Py_DECREF(collections_module);
+    PyErr_PROPAGATE_(ordered_dict);
+
     context_type.tp_name = "v8py.Context";
     context_type.tp_basicsize = sizeof(context_c);
     context_type.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE;
@@ -56,31 +66,85 @@ int context_type_init() {
 }
 
 PyObject *context_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
-    IN_V8;
-
     double timeout = 0;
-    static const char *keywords[] = {"global", "timeout", NULL};
+    double cpu_timeout = 0;
+    Py_ssize_t compile_cache_size = DEFAULT_COMPILE_CACHE_SIZE;
+    PyObject *script_retention = NULL;
+    const char *convert = "deep";
+    static const char *keywords[] = {"global", "timeout", "isolate", "release_gil", "cpu_timeout", "snapshot",
+        "compile_cache_size", "script_retention", "convert", NULL};
 
     PyObject *global = NULL;
-    if (PyArg_ParseTupleAndKeywords(args, kwargs, "|Od", (char **) keywords, &global, &timeout) < 0) {
+    PyObject *isolate_spec = Py_None;
+    PyObject *release_gil = Py_False;
+    PyObject *snapshot = Py_None;
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "|OdOOdOnOs", (char **) keywords,
+                &global, &timeout, &isolate_spec, &release_gil, &cpu_timeout, &snapshot,
+                &compile_cache_size, &script_retention, &convert) < 0) {
         return NULL;
     }
+    int convert_policy = convert_policy_from_name(convert);
+    if (convert_policy < 0) {
+        return NULL;
+    }
+    if (snapshot != Py_None && !PyObject_TypeCheck(snapshot, &snapshot_type)) {
+        PyErr_SetString(PyExc_TypeError, "snapshot must be a Snapshot or None");
+        return NULL;
+    }
+
+    // a context comes out of a snapshot by creating it in an isolate that
+    // was started from the snapshot
+    isolate_c *py_isolate;
+    if (snapshot != Py_None && isolate_spec == Py_None) {
+        py_isolate = snapshot_get_isolate((snapshot_c *) snapshot);
+    } else {
+        py_isolate = isolate_choose(isolate_spec);
+    }
+    PyErr_PROPAGATE(py_isolate);
+    if (snapshot != Py_None && py_isolate->snapshot_blob != ((snapshot_c *) snapshot)->blob) {
+        Py_DECREF(py_isolate);
+        PyErr_SetString(PyExc_ValueError, "isolate was not created from this snapshot");
+        return NULL;
+    }
+
     if (global != NULL) {
         if (PyType_Check(global) || PyClass_Check(global)) {
             PyObject *no_args = PyTuple_New(0);
-            PyErr_PROPAGATE(no_args);
+            if (no_args == NULL) {
+                Py_DECREF(py_isolate);
+                return NULL;
+            }
             global = PyObject_Call(global, no_args, NULL);
             Py_DECREF(no_args);
-            PyErr_PROPAGATE(global);
+            if (global == NULL) {
+                Py_DECREF(py_isolate);
+                return NULL;
+            }
         } else {
             Py_INCREF(global);
         }
     }
 
     context_c *self = (context_c *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        Py_XDECREF(global);
+        Py_DECREF(py_isolate);
+        return NULL;
+    }
+    self->py_isolate = py_isolate;
+    py_isolate->contexts++;
     self->has_debugger = false;
+    self->release_gil = PyObject_IsTrue(release_gil) == 1;
+    self->convert = convert_policy;
     self->timeout = timeout;
-    PyErr_PROPAGATE(self);
+    self->cpu_timeout = cpu_timeout;
+    self->last_cpu_time = 0;
+    self->cpu_time = 0;
+    self->compile_cache_size = compile_cache_size;
+    self->compile_cache_hits = 0;
+    self->compile_cache_misses = 0;
+
+    IN_V8(py_isolate->isolate);
 
     MaybeLocal<ObjectTemplate> global_template;
     if (global != NULL) {
@@ -103,6 +167,7 @@ PyObject *context_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
     context->SetEmbedderData(CONTEXT_OBJECT_SLOT, External::New(isolate, self));
     context->SetEmbedderData(OBJECT_PROTOTYPE_SLOT, Object::New(isolate)->GetPrototype());
     context->SetEmbedderData(ERROR_PROTOTYPE_SLOT, Exception::Error(String::Empty(isolate)).As<Object>()->GetPrototype());
+    context->SetEmbedderData(ARRAY_PROTOTYPE_SLOT, Array::New(isolate)->GetPrototype());
 
     PyObject *weakref_module = PyImport_ImportModule("weakref");
     PyErr_PROPAGATE(weakref_module);
@@ -110,9 +175,23 @@ PyObject *context_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
     PyErr_PROPAGATE(weak_key_dict);
     self->js_object_cache = PyObject_CallObject(weak_key_dict, NULL);
     PyErr_PROPAGATE(self->js_object_cache);
+    self->js_object_id_cache = PyDict_New();
+    PyErr_PROPAGATE(self->js_object_id_cache);
+    self->js_object_id_cache_sweep = JS_OBJECT_ID_CACHE_MIN_SWEEP;
+    self->debug_scripts = PyObject_CallObject(weak_key_dict, NULL);
+    PyErr_PROPAGATE(self->debug_scripts);
 
-    self->scripts = PySet_New(NULL);
+    self->scripts = PyObject_CallObject(ordered_dict, NULL);
     PyErr_PROPAGATE(self->scripts);
+    self->script_retention = RETAIN_ALL;
+    if (script_retention != NULL && context_set_script_retention(self, script_retention, NULL) < 0) {
+        // dealloc gives back the isolate
+        Py_XDECREF(global);
+        Py_DECREF(self);
+        return NULL;
+    }
+    self->compile_cache = PyObject_CallObject(ordered_dict, NULL);
+    PyErr_PROPAGATE(self->compile_cache);
 
     if (global != NULL) {
         py_class_init_js_object(context->Global()->GetPrototype().As<Object>(), global, context);
@@ -134,7 +213,9 @@ PyObject *context_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
     return (PyObject *) self;
 }
 
-static void js_promise_fulfilled_callback(const FunctionCallbackInfo<Value> &info) {
+void js_promise_fulfilled_callback(const FunctionCallbackInfo<Value> &info) {
+    WITH_GIL;
+    Isolate *isolate = info.GetIsolate();
     HandleScope hs(isolate);
     Local<Context> context = isolate->GetCurrentContext();
     PyObject *future = (PyObject *) info[0].As<External>()->Value();
@@ -149,7 +230,9 @@ static void js_promise_fulfilled_callback(const FunctionCallbackInfo<Value> &inf
     }
 }
 
-static void js_promise_rejected_callback(const FunctionCallbackInfo<Value> &info) {
+void js_promise_rejected_callback(const FunctionCallbackInfo<Value> &info) {
+    WITH_GIL;
+    Isolate *isolate = info.GetIsolate();
     HandleScope hs(isolate);
     Local<Context> context = isolate->GetCurrentContext();
     PyObject *future = (PyObject *) info[0].As<External>()->Value();
@@ -165,7 +248,7 @@ static void js_promise_rejected_callback(const FunctionCallbackInfo<Value> &info
 }
 
 Local<Function> bind_function(context_c *self, Local<Context> context, int argc, Local<Value> argv[], Local<Function> function) {
-    Local<Function> bind = self->bind_function.Get(isolate);
+    Local<Function> bind = self->bind_function.Get(context->GetIsolate());
     return bind->Call(context, function, argc, argv).ToLocalChecked().As<Function>();
 }
 
@@ -198,7 +281,7 @@ PyObject *context_async_call(context_c *self, PyObject *args, PyObject *kwargs)
 
     js_function *function = (js_function *)call_function;
 
-    IN_V8;
+    IN_V8(function->py_isolate->isolate);
     Local<Object> object = function->object.Get(isolate);
     IN_CONTEXT(object->CreationContext());
     JS_TRY
@@ -216,12 +299,12 @@ PyObject *context_async_call(context_c *self, PyObject *args, PyObject *kwargs)
     if (argc <= 16) {
         Local<Value> argv[argc];
         jss_from_pys(call_args, argv, context);
-        result = object->CallAsFunction(context, js_this, argc, argv);
+        CONTEXT_RUN(context, result = object->CallAsFunction(context, js_this, argc, argv));
     } else {
 #endif
         Local<Value> *argv = new Local<Value>[argc];
         jss_from_pys(call_args, argv, context);
-        result = object->CallAsFunction(context, js_this, argc, argv);
+        CONTEXT_RUN(context, result = object->CallAsFunction(context, js_this, argc, argv));
         delete[] argv;
 #ifndef _WIN32
     }
@@ -305,7 +388,7 @@ PyObject *context_async_call(context_c *self, PyObject *args, PyObject *kwargs)
 }
 
 PyObject *context_bind_py_function(context_c *self, PyObject *args) {
-    IN_V8;
+    IN_V8(self->py_isolate->isolate);
     IN_CONTEXT(self->js_context.Get(isolate))
     JS_TRY
 
@@ -345,17 +428,26 @@ PyObject *context_bind_py_function(context_c *self, PyObject *args) {
 }
 
 void context_dealloc(context_c *self) {
-    self->js_context.Reset();
-    self->promise_fulfilled.Reset();
-    self->promise_rejected.Reset();
-    self->bind_function.Reset();
-    Py_DECREF(self->js_object_cache);
-    Py_DECREF(self->scripts);
+    isolate_c *py_isolate = self->py_isolate;
+    {
+        IsolateLocker locker(py_isolate->isolate);
+        self->js_context.Reset();
+        self->promise_fulfilled.Reset();
+        self->promise_rejected.Reset();
+        self->bind_function.Reset();
+    }
+    Py_XDECREF(self->js_object_cache);
+    Py_XDECREF(self->js_object_id_cache);
+    Py_XDECREF(self->debug_scripts);
+    Py_XDECREF(self->scripts);
+    Py_XDECREF(self->compile_cache);
     Py_TYPE(self)->tp_free((PyObject *) self);
+    py_isolate->contexts--;
+    Py_DECREF(py_isolate);
 }
 
 PyObject *context_expose(context_c *self, PyObject *args, PyObject *kwargs) {
-    IN_V8;
+    IN_V8(self->py_isolate->isolate);
     Local<Context> context = self->js_context.Get(isolate);
     Local<Object> global = context->Global();
 
@@ -425,89 +517,132 @@ PyObject *context_expose_module(context_c *self, PyObject *module) {
     return result;
 }
 
-#ifdef _WIN32
-
-UINT s_timer_id;
-
-static void CALLBACK breaker_callback(UINT uTimerID, UINT uMsg, DWORD dwUser, DWORD dw1, DWORD dw2) {
-    isolate->TerminateExecution();
+double context_timeout(Local<Context> context) {
+    return context_get_object(context)->timeout;
 }
 
-#else
-
-pthread_t breaker_id;
-useconds_t s_timeout;
-
-void *breaker_thread(void *param) {
-    useconds_t timeout = *(useconds_t *) param;
-    usleep(timeout);
-    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
-    isolate->TerminateExecution();
-    return NULL;
+double context_cpu_timeout(Local<Context> context) {
+    return context_get_object(context)->cpu_timeout;
 }
-#endif
 
-static double context_timeout(Local<Context> context) {
-    context_c *ctx_c = (context_c *) context->GetEmbedderData(CONTEXT_OBJECT_SLOT).As<External>()->Value();
-    return ctx_c->timeout;
+// Drops the least recently used entries of an OrderedDict until it fits
+static int lru_trim(PyObject *lru, Py_ssize_t size) {
+    while (PyObject_Size(lru) > size) {
+        PyObject *item = PyObject_CallMethod(lru, (char *) "popitem", (char *) "O", Py_False);
+        PyErr_PROPAGATE_(item);
+        Py_DECREF(item);
+    }
+    return 0;
 }
 
-static bool setup_timeout(double timeout) {
-#ifdef _WIN32
-    if (timeout > 0) {
-        UINT timeout_ = (UINT) (timeout * 1000);
-        s_timer_id = timeSetEvent(timeout_, 0, (LPTIMECALLBACK) breaker_callback, 0,
-            TIME_ONESHOT | TIME_CALLBACK_FUNCTION | TIME_KILL_SYNCHRONOUS);
-        if (s_timer_id == NULL) {
-            PyErr_SetFromErrno(PyExc_OSError);
-            return false;
-        }
+// Marks key as the most recently used entry of an OrderedDict, adding it if needed
+static int lru_touch(PyObject *lru, PyObject *key, PyObject *value) {
+    if (PyDict_GetItem(lru, key) == NULL) {
+        return PyObject_SetItem(lru, key, value);
     }
+#if PY_MAJOR_VERSION >= 3
+    PyObject *moved = PyObject_CallMethod(lru, (char *) "move_to_end", (char *) "O", key);
 #else
-    if (timeout > 0) {
-        s_timeout = (useconds_t) (timeout * 1000000);
-        errno = pthread_create(&breaker_id, NULL, breaker_thread, &s_timeout);
-        if (errno) {
-            PyErr_SetFromErrno(PyExc_OSError);
-            return false;
-        }
+    PyObject *moved = PyObject_CallMethod(lru, (char *) "pop", (char *) "O", key);
+    if (moved != NULL && PyObject_SetItem(lru, key, value) < 0) {
+        Py_CLEAR(moved);
     }
 #endif
-    return true;
+    PyErr_PROPAGATE_(moved);
+    Py_DECREF(moved);
+    return 0;
 }
 
-static bool cleanup_timeout(double timeout) {
-#ifdef _WIN32
-    if (timeout > 0 && s_timer_id != NULL) {
-        timeKillEvent(s_timer_id);
+// Keeps a script that's being evaluated according to the retention policy
+static int context_retain_script(context_c *self, PyObject *script) {
+    if (self->script_retention == RETAIN_REFERENCED) {
+        return 0;
     }
-#else
-    if (timeout > 0) {
-        pthread_cancel(breaker_id);
-        errno = pthread_join(breaker_id, NULL);
-        if (errno) {
-            PyErr_SetFromErrno(PyExc_OSError);
-            return false;
-        }
+    if (lru_touch(self->scripts, script, Py_None) < 0) {
+        return -1;
     }
-#endif
-    return true;
+    if (self->script_retention != RETAIN_ALL) {
+        return lru_trim(self->scripts, self->script_retention);
+    }
+    return 0;
 }
 
-bool context_setup_timeout(Local<Context> context) {
-    return setup_timeout(context_timeout(context));
+// Returns the Script for a string program, compiling it only if it's not in
+// the cache. Hashing the source is much cheaper than compiling it, and str
+// objects remember their hash anyway.
+// These never get V8 code caches, there's one per distinct string.
+static PyObject *context_compile_cached(context_c *self, PyObject *source, PyObject *filename) {
+    if (self->compile_cache_size <= 0) {
+        return PyObject_CallFunctionObjArgs((PyObject *) &script_type, source, filename, self->py_isolate, Py_False, NULL);
+    }
+    PyObject *key = PyTuple_Pack(2, source, filename);
+    PyErr_PROPAGATE(key);
+
+    // reading an OrderedDict as a plain dict is fine, writing it isn't
+    PyObject *script = PyDict_GetItem(self->compile_cache, key);
+    if (script != NULL) {
+        self->compile_cache_hits++;
+        Py_INCREF(script);
+        int failed = lru_touch(self->compile_cache, key, script);
+        Py_DECREF(key);
+        if (failed < 0) {
+            Py_DECREF(script);
+            return NULL;
+        }
+        return script;
+    }
+
+    self->compile_cache_misses++;
+    script = PyObject_CallFunctionObjArgs((PyObject *) &script_type, source, filename, self->py_isolate, Py_False, NULL);
+    if (script == NULL) {
+        Py_DECREF(key);
+        return NULL;
+    }
+    int failed = PyObject_SetItem(self->compile_cache, key, script);
+    Py_DECREF(key);
+    if (failed < 0 || lru_trim(self->compile_cache, self->compile_cache_size) < 0) {
+        Py_DECREF(script);
+        return NULL;
+    }
+    return script;
 }
-bool context_cleanup_timeout(Local<Context> context) {
-    return cleanup_timeout(context_timeout(context));
+
+// Scripts are compiled in the isolate's compile context, which the inspector
+// doesn't know about, so a debugger wouldn't see them. With a debugger
+// attached each script is compiled again in this context, once.
+static PyObject *context_debug_script(context_c *self, Local<Context> context, PyObject *program) {
+    PyObject *debug_script = PyObject_CallMethod(self->debug_scripts, (char *) "get", (char *) "O", program);
+    PyErr_PROPAGATE(debug_script);
+    if (debug_script != Py_None) {
+        return debug_script;
+    }
+    Py_DECREF(debug_script);
+
+    script_c *py_script = (script_c *) program;
+    debug_script = script_new_in_isolate(&script_type, self->py_isolate,
+            py_script->source, py_script->script_name, NULL, SCRIPT_CACHE_NONE, py_script->eager, context);
+    PyErr_PROPAGATE(debug_script);
+    if (PyObject_SetItem(self->debug_scripts, program, debug_script) < 0) {
+        Py_DECREF(debug_script);
+        return NULL;
+    }
+    return debug_script;
 }
 
 PyObject *context_eval(context_c *self, PyObject *args, PyObject *kwargs) {
     PyObject *program;
     PyObject *filename = Py_None;
     double timeout = self->timeout;
-    static const char *keywords[] = {"program", "timeout", "filename", NULL};
+    double cpu_timeout = self->cpu_timeout;
+    const char *convert = NULL;
+    static const char *keywords[] = {"program", "timeout", "filename", "cpu_timeout", "convert", NULL};
     // python needs to fix their shit and make it const
-    if (PyArg_ParseTupleAndKeywords(args, kwargs, "O|dO", (char **) keywords, &program, &timeout, &filename) < 0) {
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "O|dOdz", (char **) keywords,
+                &program, &timeout, &filename, &cpu_timeout, &convert) < 0) {
+        return NULL;
+    }
+    int convert_policy = self->convert;
+    if (convert != NULL && (convert_policy = convert_policy_from_name(convert)) < 0) {
         return NULL;
     }
     if (!PyString_Check(program) && !PyObject_TypeCheck(program, &script_type)) {
@@ -516,56 +651,189 @@ PyObject *context_eval(context_c *self, PyObject *args, PyObject *kwargs) {
     }
 
     if (PyString_Check(program)) {
-        program = PyObject_CallFunctionObjArgs((PyObject *) &script_type, program, filename, NULL);
+        program = context_compile_cached(self, program, filename);
         PyErr_PROPAGATE(program);
     } else {
         Py_INCREF(program);
     }
     assert(PyObject_TypeCheck(program, &script_type));
     script_c *py_script = (script_c *) program;
+    if (py_script->py_isolate != self->py_isolate) {
+        Py_DECREF(program);
+        PyErr_SetString(PyExc_ValueError, "script was compiled in a different isolate");
+        return NULL;
+    }
 
-    IN_V8;
+    IN_V8(self->py_isolate->isolate);
     IN_CONTEXT(self->js_context.Get(isolate));
     JS_TRY
 
-    PySet_Add(self->scripts, program);
+    if (context_retain_script(self, program) < 0) {
+        Py_DECREF(program);
+        return NULL;
+    }
     Local<UnboundScript> unbound_script;
     if (self->has_debugger) {
-        MaybeLocal<UnboundScript> maybe_script = script_compile(context, py_script->source, py_script->script_name);
-        PY_PROPAGATE_JS;
-        unbound_script = maybe_script.ToLocalChecked();
+        PyObject *debug_script = context_debug_script(self, context, program);
+        if (debug_script == NULL) {
+            Py_DECREF(program);
+            return NULL;
+        }
+        unbound_script = ((script_c *) debug_script)->script.Get(isolate);
+        Py_DECREF(debug_script);
     } else {
         unbound_script = py_script->script.Get(isolate);
     }
     Py_DECREF(program);
     Local<Script> script = unbound_script->BindToCurrentContext();
 
-    if (!setup_timeout(timeout)) return NULL;
-    MaybeLocal<Value> result = script->Run(context);
-    if (!cleanup_timeout(timeout)) return NULL;
+    Deadline deadline(isolate, timeout, cpu_timeout);
+    MaybeLocal<Value> result;
+    CONTEXT_RUN(context, result = script->Run(context));
+
+    PY_PROPAGATE_JS;
+    return py_from_js(result.ToLocalChecked(), context, convert_policy);
+}
+
+// Compiles source as the body of a function taking params, in this context.
+// The function compiles once and can be called with different arguments as
+// often as needed, instead of formatting the values into a new script.
+PyObject *context_compile_function(context_c *self, PyObject *args, PyObject *kwargs) {
+    PyObject *source;
+    PyObject *params = NULL;
+    PyObject *filename = Py_None;
+    static const char *keywords[] = {"source", "params", "filename", NULL};
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO", (char **) keywords, &source, &params, &filename) < 0) {
+        return NULL;
+    }
+    if (!PyString_Check(source)) {
+        PyErr_SetString(PyExc_TypeError, "source must be a string");
+        return NULL;
+    }
+    if (filename != Py_None && !PyString_Check(filename)) {
+        PyErr_SetString(PyExc_TypeError, "filename must be a string or None");
+        return NULL;
+    }
+    if (params == NULL || params == Py_None) {
+        params = PyTuple_New(0);
+    } else {
+        params = PySequence_Fast(params, "params must be a sequence of strings");
+    }
+    PyErr_PROPAGATE(params);
+    Py_ssize_t param_count = PySequence_Fast_GET_SIZE(params);
+    for (Py_ssize_t i = 0; i < param_count; i++) {
+        if (!PyString_Check(PySequence_Fast_GET_ITEM(params, i))) {
+            Py_DECREF(params);
+            PyErr_SetString(PyExc_TypeError, "params must be a sequence of strings");
+            return NULL;
+        }
+    }
+
+    IN_V8(self->py_isolate->isolate);
+    IN_CONTEXT(self->js_context.Get(isolate));
+    JS_TRY
 
+    Local<String> *js_params = new Local<String>[param_count + 1];
+    for (Py_ssize_t i = 0; i < param_count; i++) {
+        js_params[i] = js_from_py(PySequence_Fast_GET_ITEM(params, i), context).As<String>();
+    }
+    Py_DECREF(params);
+    Local<String> js_source = js_from_py(source, context).As<String>();
+    MaybeLocal<Function> function;
+    // fucking god / c++
+    if (filename != Py_None) {
+        ScriptOrigin origin(js_from_py(filename, context));
+        ScriptCompiler::Source js_function_source(js_source, origin);
+        function = ScriptCompiler::CompileFunctionInContext(context, &js_function_source,
+                param_count, js_params, 0, NULL);
+    } else {
+        ScriptCompiler::Source js_function_source(js_source);
+        function = ScriptCompiler::CompileFunctionInContext(context, &js_function_source,
+                param_count, js_params, 0, NULL);
+    }
+    delete[] js_params;
     PY_PROPAGATE_JS;
-    return py_from_js(result.ToLocalChecked(), context);
+    return py_from_js(function.ToLocalChecked(), context);
 }
 
+context_c *context_get_object(Local<Context> context) {
+    return (context_c *) context->GetEmbedderData(CONTEXT_OBJECT_SLOT).As<External>()->Value();
+}
+
+// The cached object is the JSObject for a weak handle, which is empty once
+// the JavaScript object is collected
 Local<Object> context_get_cached_jsobject(Local<Context> js_context, PyObject *py_object) {
+    Isolate *isolate = js_context->GetIsolate();
     EscapableHandleScope hs(isolate);
     context_c *self = (context_c *) js_context->GetEmbedderData(CONTEXT_OBJECT_SLOT).As<External>()->Value();
+    if (!PyType_SUPPORTS_WEAKREFS(Py_TYPE(py_object))) {
+        PyObject *key = PyLong_FromVoidPtr(py_object);
+        if (key == NULL) {
+            PyErr_Clear();
+            return Local<Object>();
+        }
+        // borrowed
+        js_object *jsobj = (js_object *) PyDict_GetItem(self->js_object_id_cache, key);
+        Py_DECREF(key);
+        if (jsobj == NULL) {
+            return Local<Object>();
+        }
+        return hs.Escape(jsobj->object.Get(isolate));
+    }
     if (PyMapping_HasKey(self->js_object_cache, py_object)) {
         js_object *jsobj = (js_object *) PyObject_GetItem(self->js_object_cache, py_object);
         if (jsobj == NULL) {
             // fuck
             PyErr_WriteUnraisable(PyString_InternFromString("v8py py_class_create_js_object getitem"));
+            return Local<Object>();
         }
-        return hs.Escape(jsobj->object.Get(isolate));
+        Local<Object> object = jsobj->object.Get(isolate);
+        Py_DECREF(jsobj);
+        return hs.Escape(object);
     }
     return Local<Object>();
 }
 
+static void context_sweep_id_cache(context_c *self) {
+    PyObject *dead = PyList_New(0);
+    if (dead == NULL) {
+        PyErr_Clear();
+        return;
+    }
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(self->js_object_id_cache, &pos, &key, &value)) {
+        if (((js_object *) value)->object.IsEmpty() && PyList_Append(dead, key) < 0) {
+            PyErr_Clear();
+        }
+    }
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(dead); i++) {
+        PyDict_DelItem(self->js_object_id_cache, PyList_GET_ITEM(dead, i));
+    }
+    Py_DECREF(dead);
+    Py_ssize_t size = PyDict_Size(self->js_object_id_cache);
+    self->js_object_id_cache_sweep = size * 2 > JS_OBJECT_ID_CACHE_MIN_SWEEP ? size * 2 : JS_OBJECT_ID_CACHE_MIN_SWEEP;
+}
+
 void context_set_cached_jsobject(Local<Context> js_context, PyObject *py_object, Local<Object> object) {
-    EscapableHandleScope hs(isolate);
+    HandleScope hs(js_context->GetIsolate());
     context_c *self = (context_c *) js_context->GetEmbedderData(CONTEXT_OBJECT_SLOT).As<External>()->Value();
     js_object *jsobj = js_object_weak_new(object, js_context);
+    if (jsobj == NULL) {
+        PyErr_Clear();
+        return;
+    }
+    if (!PyType_SUPPORTS_WEAKREFS(Py_TYPE(py_object))) {
+        if (PyDict_Size(self->js_object_id_cache) >= self->js_object_id_cache_sweep) {
+            context_sweep_id_cache(self);
+        }
+        PyObject *key = PyLong_FromVoidPtr(py_object);
+        if (key == NULL || PyDict_SetItem(self->js_object_id_cache, key, (PyObject *) jsobj) < 0) {
+            PyErr_Clear();
+        }
+        Py_XDECREF(key);
+        return;
+    }
     if (PyObject_SetItem(self->js_object_cache, py_object, (PyObject *) jsobj) < 0) {
         if (PyErr_ExceptionMatches(PyExc_TypeError)) {
             // if it's a type error, it's probably "cannot create weak reference" and should be ignored.
@@ -577,6 +845,10 @@ void context_set_cached_jsobject(Local<Context> js_context, PyObject *py_object,
 }
 
 PyObject *context_get_current(PyObject *shit, PyObject *fuck) {
+    CURRENT_ISOLATE;
+    if (isolate == NULL) {
+        Py_RETURN_NONE;
+    }
     Local<Context> current_context = isolate->GetCurrentContext();
     if (current_context.IsEmpty()) {
         Py_RETURN_NONE;
@@ -595,12 +867,141 @@ int *context_set_timeout(context_c *self, PyObject *value, void *shit) {
     return 0;
 }
 
+PyObject *context_get_cpu_timeout(context_c *self, void *shit) {
+    return PyFloat_FromDouble(self->cpu_timeout);
+}
+
+int context_set_cpu_timeout(context_c *self, PyObject *value, void *shit) {
+    double cpu_timeout = PyFloat_AsDouble(value);
+    if (cpu_timeout == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+    self->cpu_timeout = cpu_timeout;
+    return 0;
+}
+
+PyObject *context_get_last_cpu_time(context_c *self, void *shit) {
+    return PyFloat_FromDouble(self->last_cpu_time);
+}
+
+PyObject *context_get_cpu_time(context_c *self, void *shit) {
+    return PyFloat_FromDouble(self->cpu_time);
+}
+
+PyObject *context_get_script_retention(context_c *self, void *shit) {
+    if (self->script_retention == RETAIN_ALL) {
+        return PyString_InternFromString("all");
+    }
+    if (self->script_retention == RETAIN_REFERENCED) {
+        return PyString_InternFromString("referenced");
+    }
+    return PyLong_FromSsize_t(self->script_retention);
+}
+
+static int string_equals(PyObject *value, const char *string) {
+    PyObject *other = PyString_InternFromString(string);
+    PyErr_PROPAGATE_(other);
+    int equal = PyObject_RichCompareBool(value, other, Py_EQ);
+    Py_DECREF(other);
+    return equal;
+}
+
+int context_set_script_retention(context_c *self, PyObject *value, void *shit) {
+    Py_ssize_t retention;
+    if (PyString_Check(value) && string_equals(value, "all") == 1) {
+        retention = RETAIN_ALL;
+    } else if (PyString_Check(value) && string_equals(value, "referenced") == 1) {
+        retention = RETAIN_REFERENCED;
+    } else if (PyIndex_Check(value)) {
+        retention = PyNumber_AsSsize_t(value, PyExc_OverflowError);
+        if (retention == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        if (retention <= 0) {
+            PyErr_SetString(PyExc_ValueError, "script_retention must keep at least one script");
+            return -1;
+        }
+    } else {
+        PyErr_SetString(PyExc_ValueError, "script_retention must be 'all', 'referenced' or a number of scripts");
+        return -1;
+    }
+    self->script_retention = retention;
+    if (retention == RETAIN_ALL) {
+        return 0;
+    }
+    return lru_trim(self->scripts, retention);
+}
+
+PyObject *context_get_compile_cache_size(context_c *self, void *shit) {
+    return PyLong_FromSsize_t(self->compile_cache_size);
+}
+
+int context_set_compile_cache_size(context_c *self, PyObject *value, void *shit) {
+    Py_ssize_t size = PyNumber_AsSsize_t(value, PyExc_OverflowError);
+    if (size == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+    self->compile_cache_size = size;
+    return lru_trim(self->compile_cache, size > 0 ? size : 0);
+}
+
+PyObject *context_get_compile_cache_hits(context_c *self, void *shit) {
+    return PyLong_FromSsize_t(self->compile_cache_hits);
+}
+
+PyObject *context_get_compile_cache_misses(context_c *self, void *shit) {
+    return PyLong_FromSsize_t(self->compile_cache_misses);
+}
+
+PyObject *context_get_release_gil(context_c *self, void *shit) {
+    return PyBool_FromLong(self->release_gil);
+}
+
+int context_set_release_gil(context_c *self, PyObject *value, void *shit) {
+    int release_gil = PyObject_IsTrue(value);
+    if (release_gil < 0) {
+        return -1;
+    }
+    self->release_gil = release_gil;
+    return 0;
+}
+
+PyObject *context_get_convert(context_c *self, void *shit) {
+    return PyString_InternFromString(convert_policy_name(self->convert));
+}
+
+int context_set_convert(context_c *self, PyObject *value, void *shit) {
+    const char *convert;
+    if (value == NULL || !PyArg_Parse(value, "s", &convert)) {
+        PyErr_SetString(PyExc_TypeError, "convert must be 'deep', 'shallow' or 'proxy'");
+        return -1;
+    }
+    int convert_policy = convert_policy_from_name(convert);
+    if (convert_policy < 0) {
+        return -1;
+    }
+    self->convert = convert_policy;
+    return 0;
+}
+
+int context_convert_policy(Local<Context> context, const char *convert) {
+    if (convert == NULL) {
+        return context_get_object(context)->convert;
+    }
+    return convert_policy_from_name(convert);
+}
+
 PyObject *context_get_global(context_c *self, void *shit) {
-    IN_V8;
+    IN_V8(self->py_isolate->isolate);
     Local<Context> context = self->js_context.Get(isolate);
     return py_from_js(context->Global()->GetPrototype(), context);
 }
 
+PyObject *context_get_isolate(context_c *self, void *shit) {
+    Py_INCREF(self->py_isolate);
+    return (PyObject *) self->py_isolate;
+}
+
 PyObject *context_getattro(context_c *self, PyObject *name) {
     PyObject *value = PyObject_GenericGetAttr((PyObject *) self, name);
     if (value == NULL) {
@@ -612,7 +1013,9 @@ PyObject *context_getattro(context_c *self, PyObject *name) {
 PyObject *context_getitem(context_c *self, PyObject *name) {
     PyObject *global = context_get_global(self, NULL);
     PyErr_PROPAGATE(global);
-    return PyObject_GetAttr(context_get_global(self, NULL), name);
+    PyObject *value = PyObject_GetAttr(global, name);
+    Py_DECREF(global);
+    return value;
 }
 
 int context_setattro(context_c *self, PyObject *name, PyObject *value) {
@@ -631,11 +1034,13 @@ int context_setattro(context_c *self, PyObject *name, PyObject *value) {
 int context_setitem(context_c *self, PyObject *name, PyObject *value) {
     PyObject *global = context_get_global(self, NULL);
     PyErr_PROPAGATE_(global);
-    return PyObject_SetAttr(global, name, value);
+    int result = PyObject_SetAttr(global, name, value);
+    Py_DECREF(global);
+    return result;
 }
 
 PyObject *context_gc(context_c *self) {
-    IN_V8;
+    IN_V8(self->py_isolate->isolate);
     isolate->RequestGarbageCollectionForTesting(Isolate::GarbageCollectionType::kFullGarbageCollection);
     Py_RETURN_NONE;
 }
@@ -5,47 +5,131 @@
 #include <v8.h>
 
 #include "pyfunction.h"
+#include "isolate.h"
+#include "watchdog.h"
 
 using namespace v8;
 
 typedef struct context_c_ {
     PyObject_HEAD
+    isolate_c *py_isolate;
     Persistent<Context> js_context;
     Persistent<Function> promise_fulfilled;
     Persistent<Function> promise_rejected;
     Persistent<Function> bind_function;
     PyObject *js_object_cache;
+    // the same for objects that can't be weakly referenced (dicts and lists
+    // passed live), keyed by address. The JavaScript object keeps the Python
+    // object alive, so the address can't be reused while the entry is good.
+    // Dead entries get swept out when it grows past js_object_id_cache_sweep.
+    PyObject *js_object_id_cache;
+    Py_ssize_t js_object_id_cache_sweep;
+    // Scripts evaluated in the context, kept so tracebacks through them can
+    // show source, in the order they were last evaluated
     PyObject *scripts;
+    // how many of them to keep, see RETAIN_ALL and RETAIN_REFERENCED
+    Py_ssize_t script_retention;
+    // LRU of Scripts compiled from strings passed to eval, keyed by (source, filename)
+    PyObject *compile_cache;
+    Py_ssize_t compile_cache_size;
+    Py_ssize_t compile_cache_hits;
+    Py_ssize_t compile_cache_misses;
+    // Scripts compiled again in this context while a debugger is attached,
+    // so the inspector knows about them. Weakly keyed by the original Script.
+    PyObject *debug_scripts;
     bool has_debugger;
+    bool release_gil;
+    // CONVERT_DEEP, CONVERT_SHALLOW or CONVERT_PROXY, for what eval and
+    // function calls return
+    int convert;
     double timeout;
+    double cpu_timeout;
+    // CPU time spent running JavaScript, for the last run and in total
+    double last_cpu_time;
+    double cpu_time;
 } context_c;
 int context_type_init();
 
-bool context_setup_timeout(Local<Context> context);
-bool context_cleanup_timeout(Local<Context> context);
+context_c *context_get_object(Local<Context> context);
+
+// Runs a statement that executes JavaScript in context. If the context has
+// release_gil set, other Python threads get to run while it does. The CPU
+// time it takes is added to the context's counters.
+#define CONTEXT_RUN(context, statement) { \
+    context_c *run_context = context_get_object(context); \
+    CPUMeter cpu_meter(&run_context->last_cpu_time, &run_context->cpu_time); \
+    if (run_context->release_gil) { \
+        run_context->py_isolate->gil_released++; \
+        Py_BEGIN_ALLOW_THREADS \
+        statement; \
+        Py_END_ALLOW_THREADS \
+        run_context->py_isolate->gil_released--; \
+    } else { \
+        statement; \
+    } \
+}
+
+double context_timeout(Local<Context> context);
+double context_cpu_timeout(Local<Context> context);
+// Arms the context's timeouts until the end of the enclosing scope
+#define CONTEXT_DEADLINE(context) \
+    Deadline deadline(context->GetIsolate(), context_timeout(context), context_cpu_timeout(context))
 
 void context_dealloc(context_c *self);
 PyObject *context_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
 PyObject *context_eval(context_c *self, PyObject *args, PyObject *kwargs);
+PyObject *context_compile_function(context_c *self, PyObject *args, PyObject *kwargs);
 PyObject *context_expose(context_c *self, PyObject *args, PyObject *kwargs);
 PyObject *context_expose_module(context_c *self, PyObject *module);
 PyObject *context_async_call(context_c *self, PyObject *args, PyObject *kwargs);
 PyObject *context_bind_py_function(context_c *self, PyObject *args);
 PyObject *context_gc(context_c *self);
 
+#define DEFAULT_COMPILE_CACHE_SIZE 256
+#define JS_OBJECT_ID_CACHE_MIN_SWEEP 64
+
+// Values for script_retention besides a number of scripts. With
+// RETAIN_REFERENCED the context doesn't keep any, so a script lives as long
+// as something else references it.
+#define RETAIN_ALL -1
+#define RETAIN_REFERENCED 0
+
 // Embedder data slots
 #define CONTEXT_OBJECT_SLOT 1
 #define OBJECT_PROTOTYPE_SLOT 2
 #define ERROR_PROTOTYPE_SLOT 3
+#define ARRAY_PROTOTYPE_SLOT 4
 
 Local<Object> context_get_cached_jsobject(Local<Context> context, PyObject *py_object);
 void context_set_cached_jsobject(Local<Context> context, PyObject *py_object, Local<Object> object);
 
 PyObject *context_get_current(PyObject *shit, PyObject *fuck);
 PyObject *context_get_global(context_c *self, void *shit);
+PyObject *context_get_isolate(context_c *self, void *shit);
 
 PyObject *context_get_timeout(context_c *self, void *shit);
 int *context_set_timeout(context_c *self, PyObject *value, void *shit);
+PyObject *context_get_cpu_timeout(context_c *self, void *shit);
+int context_set_cpu_timeout(context_c *self, PyObject *value, void *shit);
+PyObject *context_get_last_cpu_time(context_c *self, void *shit);
+PyObject *context_get_cpu_time(context_c *self, void *shit);
+PyObject *context_get_script_retention(context_c *self, void *shit);
+int context_set_script_retention(context_c *self, PyObject *value, void *shit);
+PyObject *context_get_compile_cache_size(context_c *self, void *shit);
+int context_set_compile_cache_size(context_c *self, PyObject *value, void *shit);
+PyObject *context_get_compile_cache_hits(context_c *self, void *shit);
+PyObject *context_get_compile_cache_misses(context_c *self, void *shit);
+PyObject *context_get_release_gil(context_c *self, void *shit);
+int context_set_release_gil(context_c *self, PyObject *value, void *shit);
+PyObject *context_get_convert(context_c *self, void *shit);
+int context_set_convert(context_c *self, PyObject *value, void *shit);
+
+// The policy for converting a result, from a convert keyword argument that
+// may be NULL, or -1 with an exception
+int context_convert_policy(Local<Context> context, const char *convert);
+
+void js_promise_fulfilled_callback(const FunctionCallbackInfo<Value> &info);
+void js_promise_rejected_callback(const FunctionCallbackInfo<Value> &info);
 
 Local<Function> bind_function(context_c *self, Local<Context> context, int argc, Local<Value> argv[], Local<Function> function);
 PyObject *context_getattro(context_c *self, PyObject *name);
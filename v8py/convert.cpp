@@ -7,9 +7,425 @@
 #include "pyclass.h"
 #include "jsobject.h"
 #include "context.h"
+#include "transcode.h"
+#include "buffer.h"
+#include "names.h"
+#include "live.h"
 
-PyObject *py_from_js(Local<Value> value, Local<Context> context) {
-    IN_V8;
+#include <vector>
+
+PyObject *py_from_utf16(const uint16_t *data, size_t length) {
+#if PY_MAJOR_VERSION >= 3
+    PyObject *py_value;
+    int string_class = utf16_classify(data, length);
+    if (string_class == UTF16_ASCII || string_class == UTF16_LATIN1) {
+        py_value = PyUnicode_New(length, string_class == UTF16_ASCII ? 127 : 255);
+        PyErr_PROPAGATE(py_value);
+        utf16_to_latin1(data, length, PyUnicode_1BYTE_DATA(py_value));
+        return py_value;
+    }
+    if (string_class == UTF16_SURROGATES) {
+        py_value = PyUnicode_New(length, 0x10ffff);
+        PyErr_PROPAGATE(py_value);
+        size_t decoded = utf16_to_ucs4(data, length, (uint32_t *) PyUnicode_4BYTE_DATA(py_value));
+        if (decoded < length) {
+            if (PyUnicode_Resize(&py_value, decoded) < 0) {
+                return NULL;
+            }
+            return py_value;
+        }
+        // only lone surrogates, which fit in UCS-2 like everything else
+        Py_DECREF(py_value);
+    }
+    py_value = PyUnicode_New(length, 0xffff);
+    PyErr_PROPAGATE(py_value);
+    memcpy(PyUnicode_2BYTE_DATA(py_value), data, length * sizeof(uint16_t));
+    return py_value;
+#elif Py_UNICODE_SIZE == 2
+    return PyUnicode_FromUnicode((const Py_UNICODE *) data, length);
+#else
+    PyObject *py_value = PyUnicode_FromUnicode(NULL, length);
+    PyErr_PROPAGATE(py_value);
+    size_t decoded = utf16_to_ucs4(data, length, (uint32_t *) PyUnicode_AS_UNICODE(py_value));
+    if (decoded < length && PyUnicode_Resize(&py_value, decoded) < 0) {
+        return NULL;
+    }
+    return py_value;
+#endif
+}
+
+// Python 3 strings come in the same flavors as V8's, so one-byte strings get
+// written straight into the PyUnicode without going through UTF-16.
+PyObject *py_from_js_string(Local<String> str_value) {
+    int length = str_value->Length();
+#if PY_MAJOR_VERSION >= 3
+    if (str_value->IsOneByte()) {
+        PyObject *py_value = PyUnicode_New(length, 127);
+        PyErr_PROPAGATE(py_value);
+        uint8_t *data = (uint8_t *) PyUnicode_1BYTE_DATA(py_value);
+        str_value->WriteOneByte(data, 0, length, String::WriteOptions::NO_NULL_TERMINATION);
+        if (latin1_is_ascii(data, length)) {
+            return py_value;
+        }
+        // Latin-1 after all, which Python stores in a different layout
+        PyObject *latin1 = PyUnicode_New(length, 255);
+        if (latin1 != NULL) {
+            memcpy(PyUnicode_1BYTE_DATA(latin1), data, length);
+        }
+        Py_DECREF(py_value);
+        return latin1;
+    }
+#endif
+
+    size_t bufsize = length * sizeof(uint16_t);
+    uint16_t *buf = &string_buffer[0];
+    if (bufsize > sizeof(string_buffer)) {
+        buf = (uint16_t *) malloc(bufsize);
+        if (buf == NULL) {
+            return PyErr_NoMemory();
+        }
+    }
+    str_value->Write(buf, 0, length, String::WriteOptions::NO_NULL_TERMINATION);
+    PyObject *py_value = py_from_utf16(buf, length);
+    if (buf != &string_buffer[0]) {
+        free(buf);
+    }
+    return py_value;
+}
+
+// Long strings in Latin-1 or UCS-2 are handed to V8 as external strings
+// pointing into the Python object rather than copied into the V8 heap. The
+// object is immutable, so the memory can't change under V8, and the resource
+// keeps it alive until V8 collects the string.
+#define DEFAULT_EXTERNAL_STRING_THRESHOLD (64 * 1024)
+static Py_ssize_t external_string_threshold = DEFAULT_EXTERNAL_STRING_THRESHOLD;
+
+template <class Resource, typename Char>
+class PyExternalString : public Resource {
+    public:
+        PyExternalString(PyObject *object, const Char *data, size_t length)
+            : object_(object), data_(data), length_(length) {
+            Py_INCREF(object_);
+        }
+        const Char *data() const { return data_; }
+        size_t length() const { return length_; }
+        // V8 calls this from the garbage collector, which can run with or
+        // without the GIL
+        void Dispose() {
+            {
+                WITH_GIL;
+                Py_DECREF(object_);
+            }
+            delete this;
+        }
+
+    private:
+        PyObject *object_;
+        const Char *data_;
+        size_t length_;
+};
+typedef PyExternalString<String::ExternalOneByteStringResource, char> PyExternalOneByteString;
+typedef PyExternalString<String::ExternalStringResource, uint16_t> PyExternalTwoByteString;
+
+// data has to be Latin-1 and owned by object
+static Local<String> js_from_latin1(Isolate *isolate, PyObject *object, const uint8_t *data, Py_ssize_t length) {
+    if (external_string_threshold > 0 && length >= external_string_threshold) {
+        PyExternalOneByteString *resource = new PyExternalOneByteString(object, (const char *) data, length);
+        Local<String> js_value;
+        if (String::NewExternalOneByte(isolate, resource).ToLocal(&js_value)) {
+            return js_value;
+        }
+        resource->Dispose();
+    }
+    return String::NewFromOneByte(isolate, data, NewStringType::kNormal, length).ToLocalChecked();
+}
+
+// data has to be UTF-16 and owned by object
+static Local<String> js_from_utf16(Isolate *isolate, PyObject *object, const uint16_t *data, Py_ssize_t length) {
+    if (external_string_threshold > 0 && length >= external_string_threshold) {
+        PyExternalTwoByteString *resource = new PyExternalTwoByteString(object, data, length);
+        Local<String> js_value;
+        if (String::NewExternalTwoByte(isolate, resource).ToLocal(&js_value)) {
+            return js_value;
+        }
+        resource->Dispose();
+    }
+    return String::NewFromTwoByte(isolate, data, NewStringType::kNormal, length).ToLocalChecked();
+}
+
+PyObject *convert_set_external_string_threshold(PyObject *shit, PyObject *length) {
+    Py_ssize_t threshold = PyNumber_AsSsize_t(length, PyExc_OverflowError);
+    if (threshold == -1 && PyErr_Occurred()) {
+        return NULL;
+    }
+    if (threshold < 0) {
+        PyErr_SetString(PyExc_ValueError, "external string threshold can't be negative");
+        return NULL;
+    }
+    external_string_threshold = threshold;
+    Py_RETURN_NONE;
+}
+
+// Code points past the BMP turn into surrogate pairs
+static Local<String> js_from_ucs4(Isolate *isolate, const uint32_t *data, size_t length) {
+    size_t bufsize = length * 2 * sizeof(uint16_t);
+    uint16_t *buf = &string_buffer[0];
+    if (bufsize > sizeof(string_buffer)) {
+        buf = (uint16_t *) malloc(bufsize);
+        if (buf == NULL) {
+            isolate->ThrowException(Exception::RangeError(JSTR("Out of memory converting string")));
+            return String::Empty(isolate);
+        }
+    }
+    size_t utf16_length = ucs4_to_utf16(data, length, buf);
+    Local<String> js_value = String::NewFromTwoByte(isolate, buf, NewStringType::kNormal, utf16_length).ToLocalChecked();
+    if (buf != &string_buffer[0]) {
+        free(buf);
+    }
+    return js_value;
+}
+
+// Integers that don't fit in 32 bits become doubles, like they would in
+// JavaScript, instead of getting truncated
+static inline Local<Number> js_from_py_integer(Isolate *isolate, PyObject *value) {
+    int overflow;
+    PY_LONG_LONG n = PyLong_AsLongLongAndOverflow(value, &overflow);
+    if (overflow == 0 && n >= INT32_MIN && n <= INT32_MAX) {
+        return Integer::New(isolate, (int32_t) n);
+    }
+    if (overflow == 0 && n >= 0 && n <= UINT32_MAX) {
+        return Integer::NewFromUnsigned(isolate, (uint32_t) n);
+    }
+    if (overflow == 0) {
+        return Number::New(isolate, (double) n);
+    }
+    double d = PyLong_AsDouble(value);
+    if (d == -1 && PyErr_Occurred()) {
+        PyErr_Clear();
+        d = overflow * HUGE_VAL;
+    }
+    return Number::New(isolate, d);
+}
+
+// Dicts that share their keys get built from an ObjectTemplate that already
+// has those keys, in the same order, with internalized names. V8 clones a
+// cached instance of the template, so the object gets its final hidden class
+// in one step instead of going through a map transition for every key, and
+// the keys don't get converted again. Each isolate keeps one template per
+// key tuple it has seen, up to MAX_OBJECT_SHAPES. Only small dicts with
+// plain string keys qualify: integer-like keys would be elements rather than
+// properties, and __proto__ has to go through its setter.
+#define MAX_OBJECT_SHAPES 1024
+#define MAX_OBJECT_SHAPE_KEYS 32
+
+struct object_shape {
+    Isolate *isolate;
+    Global<ObjectTemplate> templ;
+    std::vector<Global<String>> keys;
+};
+
+static void object_shape_free(PyObject *capsule) {
+    object_shape *shape = (object_shape *) PyCapsule_GetPointer(capsule, NULL);
+    IsolateLocker locker(shape->isolate);
+    delete shape;
+}
+
+static bool object_shape_key_ok(PyObject *key) {
+    Py_ssize_t length;
+    Py_UCS4 first;
+#if PY_MAJOR_VERSION >= 3
+    if (!PyUnicode_CheckExact(key) || PyUnicode_READY(key) < 0) {
+        return false;
+    }
+    length = PyUnicode_GET_LENGTH(key);
+    if (length == 0) {
+        return false;
+    }
+    first = PyUnicode_READ_CHAR(key, 0);
+    if (length == 9 && first == '_' && PyUnicode_CompareWithASCIIString(key, "__proto__") == 0) {
+        return false;
+    }
+#else
+    if (!PyString_CheckExact(key)) {
+        return false;
+    }
+    length = PyString_GET_SIZE(key);
+    if (length == 0) {
+        return false;
+    }
+    first = (unsigned char) PyString_AS_STRING(key)[0];
+    if (length == 9 && strcmp(PyString_AS_STRING(key), "__proto__") == 0) {
+        return false;
+    }
+#endif
+    return first < '0' || first > '9';
+}
+
+static PyObject *object_shape_new(Isolate *isolate, PyObject *keys) {
+    HandleScope hs(isolate);
+    object_shape *shape = new object_shape();
+    shape->isolate = isolate;
+    Local<ObjectTemplate> templ = ObjectTemplate::New(isolate);
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(keys); i++) {
+        Local<String> name = js_internalized_from_py(isolate, PyTuple_GET_ITEM(keys, i));
+        if (name.IsEmpty()) {
+            delete shape;
+            return NULL;
+        }
+        templ->Set(name, Undefined(isolate));
+        shape->keys.emplace_back(isolate, name);
+    }
+    shape->templ.Reset(isolate, templ);
+    PyObject *capsule = PyCapsule_New(shape, NULL, object_shape_free);
+    if (capsule == NULL) {
+        delete shape;
+    }
+    return capsule;
+}
+
+// The shape for a dict's keys, or NULL if it doesn't get one. Never leaves
+// an exception set. Shapes live as long as the isolate.
+static object_shape *object_shape_for(Isolate *isolate, PyObject *dict) {
+    Py_ssize_t size = PyDict_Size(dict);
+    if (size == 0 || size > MAX_OBJECT_SHAPE_KEYS) {
+        return NULL;
+    }
+    PyObject *keys = PyTuple_New(size);
+    if (keys == NULL) {
+        PyErr_Clear();
+        return NULL;
+    }
+    PyObject *key, *value;
+    Py_ssize_t pos = 0, i = 0;
+    while (PyDict_Next(dict, &pos, &key, &value)) {
+        if (!object_shape_key_ok(key)) {
+            PyErr_Clear();
+            Py_DECREF(keys);
+            return NULL;
+        }
+        Py_INCREF(key);
+        PyTuple_SET_ITEM(keys, i++, key);
+    }
+
+    PyObject *shapes = isolate_get_object(isolate)->object_shapes;
+    PyObject *capsule = PyDict_GetItem(shapes, keys);
+    if (capsule == NULL && PyDict_Size(shapes) < MAX_OBJECT_SHAPES) {
+        capsule = object_shape_new(isolate, keys);
+        if (capsule != NULL) {
+            if (PyDict_SetItem(shapes, keys, capsule) < 0) {
+                Py_CLEAR(capsule);
+            } else {
+                // the dict's reference keeps it alive
+                Py_DECREF(capsule);
+            }
+        }
+    }
+    PyErr_Clear();
+    Py_DECREF(keys);
+    if (capsule == NULL) {
+        return NULL;
+    }
+    return (object_shape *) PyCapsule_GetPointer(capsule, NULL);
+}
+
+// Arrays are converted a chunk at a time, each chunk with its own handle
+// scope, so a huge array doesn't keep a handle per element alive
+#define ARRAY_CHUNK_SIZE 1024
+
+// What's inside an object converted with CONVERT_SHALLOW is converted with
+// this, which wraps objects and arrays as JSObjects
+#define CONVERT_WRAP 3
+
+static const char *convert_policy_names[] = {"deep", "shallow", "proxy"};
+
+int convert_policy_from_name(const char *name) {
+    for (int i = 0; i < (int) (sizeof(convert_policy_names) / sizeof(convert_policy_names[0])); i++) {
+        if (strcmp(name, convert_policy_names[i]) == 0) {
+            return i;
+        }
+    }
+    PyErr_SetString(PyExc_ValueError, "convert must be 'deep', 'shallow' or 'proxy'");
+    return -1;
+}
+
+const char *convert_policy_name(int policy) {
+    return convert_policy_names[policy];
+}
+
+// Numbers and strings are most of what's in a big array, and they don't need
+// the handle scope and full dispatch in py_from_js
+static inline PyObject *py_from_js_element(Local<Value> value, Local<Context> context, int policy) {
+    if (value->IsInt32()) {
+        return PyLong_FromLong(value.As<Int32>()->Value());
+    }
+    if (value->IsUint32()) {
+        return PyLong_FromUnsignedLong(value.As<Uint32>()->Value());
+    }
+    if (value->IsNumber()) {
+        return PyFloat_FromDouble(value.As<Number>()->Value());
+    }
+    if (value->IsString()) {
+        return py_from_js_string(value.As<String>());
+    }
+    return py_from_js(value, context, policy);
+}
+
+static PyObject *py_from_js_array(Local<Array> array, Local<Context> context, int policy) {
+    Isolate *isolate = array->GetIsolate();
+    uint32_t length = array->Length();
+    PyObject *list = PyList_New(length);
+    PyErr_PROPAGATE(list);
+    for (uint32_t start = 0; start < length; start += ARRAY_CHUNK_SIZE) {
+        HandleScope hs(isolate);
+        uint32_t end = length - start < ARRAY_CHUNK_SIZE ? length : start + ARRAY_CHUNK_SIZE;
+        for (uint32_t i = start; i < end; i++) {
+            PyObject *item = py_from_js_element(array->Get(context, i).ToLocalChecked(), context, policy);
+            if (item == NULL) {
+                Py_DECREF(list);
+                return NULL;
+            }
+            PyList_SET_ITEM(list, i, item);
+        }
+    }
+    return list;
+}
+
+// Same idea going the other way. The sequence is a list or tuple, and gets
+// looked at again after every element that isn't a number, since converting
+// it could run Python code that changes a list.
+static Local<Array> js_array_from_py(Isolate *isolate, PyObject *sequence, Local<Context> context) {
+    EscapableHandleScope hs(isolate);
+    Py_ssize_t length = PySequence_Fast_GET_SIZE(sequence);
+    Local<Array> array = Array::New(isolate, length);
+    for (Py_ssize_t start = 0; start < length; start += ARRAY_CHUNK_SIZE) {
+        HandleScope chunk_hs(isolate);
+        Py_ssize_t end = length - start < ARRAY_CHUNK_SIZE ? length : start + ARRAY_CHUNK_SIZE;
+        for (Py_ssize_t i = start; i < end && i < PySequence_Fast_GET_SIZE(sequence); i++) {
+            PyObject *item = PySequence_Fast_GET_ITEM(sequence, i);
+            Local<Value> element;
+            if (PyFloat_CheckExact(item)) {
+                element = Number::New(isolate, PyFloat_AS_DOUBLE(item));
+            } else if (PyLong_CheckExact(item)) {
+                element = js_from_py_integer(isolate, item);
+#if PY_MAJOR_VERSION < 3
+            } else if (PyInt_CheckExact(item)) {
+                element = js_from_py_integer(isolate, item);
+#endif
+            } else {
+                Py_INCREF(item);
+                element = js_from_py(item, context);
+                Py_DECREF(item);
+            }
+            bool set_worked = array->CreateDataProperty(context, i, element).FromJust();
+            assert(set_worked);
+        }
+    }
+    return hs.Escape(array);
+}
+
+PyObject *py_from_js(Local<Value> value, Local<Context> context, int policy) {
+    CURRENT_ISOLATE;
+    USING_V8;
 
     if (value->IsSymbol()) {
         value = value.As<Symbol>()->Name();
@@ -35,18 +451,21 @@ PyObject *py_from_js(Local<Value> value, Local<Context> context) {
         }
     }
 
+    // what's inside an object is converted with this
+    int element_policy = policy == CONVERT_SHALLOW ? CONVERT_WRAP : policy;
+
     if (value->IsArray()) {
         Local<Array> array = value.As<Array>();
-        PyObject *list = PyList_New(array->Length());
-        for (uint32_t i = 0; i < array->Length(); i++) {
-            PyObject *obj = py_from_js(array->Get(context, i).ToLocalChecked(), context);
-            if (obj == NULL) {
-                Py_DECREF(list);
-                return NULL;
-            }
-            PyList_SET_ITEM(list, i, obj);
+        if (context.IsEmpty()) {
+            context = array->CreationContext();
         }
-        return list;
+        if (policy == CONVERT_PROXY) {
+            return (PyObject *) js_sequence_new(array, context);
+        }
+        if (policy == CONVERT_WRAP) {
+            return (PyObject *) js_object_new(array, context);
+        }
+        return py_from_js_array(array, context, element_policy);
     }
     
     if (value->IsObject()) {
@@ -54,19 +473,37 @@ PyObject *py_from_js(Local<Value> value, Local<Context> context) {
         if (context.IsEmpty()) {
             context = obj_value->CreationContext();
         }
+        // live dicts look like plain objects, so this goes first
+        if (obj_value->InternalFieldCount() == OBJECT_INTERNAL_FIELDS) {
+            Local<Value> magic = obj_value->GetInternalField(0);
+            if (magic == IZ_DAT_OBJECT) {
+                PyObject *object = (PyObject *) obj_value->GetInternalField(1).As<External>()->Value();
+                Py_INCREF(object);
+                return object;
+            }
+        }
         if (obj_value->GetPrototype()->StrictEquals(context->GetEmbedderData(OBJECT_PROTOTYPE_SLOT))) {
+            if (policy == CONVERT_PROXY) {
+                return (PyObject *) js_mapping_new(obj_value, context);
+            }
+            if (policy == CONVERT_WRAP) {
+                return (PyObject *) js_object_new(obj_value, context);
+            }
             PyObject *dict = PyDict_New();
             PyErr_PROPAGATE(dict);
-            Local<Array> js_keys = obj_value->GetPropertyNames(context).ToLocalChecked();
+            // the prototype is Object.prototype, which has nothing enumerable
+            // of its own, so there's no point walking up to it
+            Local<Array> js_keys = obj_value->GetOwnPropertyNames(context).ToLocalChecked();
+            NameCache *names = isolate_get_object(isolate)->names;
             uint32_t length = js_keys->Length();
             for (uint32_t i = 0; i < length; i++) {
                 Local<Value> js_key = js_keys->Get(context, i).ToLocalChecked();
-                PyObject *key = py_from_js(js_key, context);
+                PyObject *key = names->py_name(js_key, context);
                 if (key == NULL) {
                     Py_DECREF(dict);
                     return NULL;
                 }
-                PyObject *value = py_from_js(obj_value->Get(context, js_key).ToLocalChecked(), context);
+                PyObject *value = py_from_js_element(obj_value->Get(context, js_key).ToLocalChecked(), context, element_policy);
                 if (value == NULL) {
                     Py_DECREF(dict);
                     Py_DECREF(key);
@@ -84,35 +521,11 @@ PyObject *py_from_js(Local<Value> value, Local<Context> context) {
             }
             return dict;
         }
-        if (obj_value->InternalFieldCount() == OBJECT_INTERNAL_FIELDS) {
-            Local<Value> magic = obj_value->GetInternalField(0);
-            if (magic == IZ_DAT_OBJECT) {
-                PyObject *object = (PyObject *) obj_value->GetInternalField(1).As<External>()->Value();
-                Py_INCREF(object);
-                return object;
-            }
-        }
         return (PyObject *) js_object_new(obj_value, context);
     }
 
     if (value->IsString()) {
-        Local<String> str_value = value.As<String>();
-        size_t bufsize = str_value->Length() * sizeof(uint16_t);
-
-        PyObject *py_value;
-
-        if (bufsize <= STRING_BUFFER_SIZE) {
-            str_value->Write(&string_buffer[0], 0, -1, String::WriteOptions::NO_NULL_TERMINATION);
-            py_value = PyUnicode_DecodeUTF16((const char *) &string_buffer[0], bufsize, NULL, NULL);
-        } else {
-            uint16_t *buf = (uint16_t *) malloc(bufsize);
-            PyErr_PROPAGATE(buf);
-            str_value->Write(buf, 0, -1, String::WriteOptions::NO_NULL_TERMINATION);
-            py_value = PyUnicode_DecodeUTF16((const char *) buf, bufsize, NULL, NULL);
-            free(buf);
-        }
-
-        return py_value;
+        return py_from_js_string(value.As<String>());
     }
     if (value->IsUint32() || value->IsInt32()) {
         return PyLong_FromLongLong((PY_LONG_LONG) value.As<Integer>()->Value());
@@ -128,7 +541,8 @@ PyObject *py_from_js(Local<Value> value, Local<Context> context) {
 }
 
 Local<Value> js_from_py(PyObject *value, Local<Context> context) {
-    ESCAPING_IN_V8;
+    CURRENT_ISOLATE;
+    ESCAPING_V8;
 
     if (value == Py_False) {
         return hs.Escape(False(isolate));
@@ -144,42 +558,86 @@ Local<Value> js_from_py(PyObject *value, Local<Context> context) {
     }
 
 #if PY_MAJOR_VERSION >= 3
-    if (PyUnicode_Check(value)) {
-        Py_ssize_t len;
-        const char *str = PyUnicode_AsUTF8AndSize(value, &len);
-        Local<String> js_value = String::NewFromUtf8(isolate, str, NewStringType::kNormal, len).ToLocalChecked();
-        return hs.Escape(js_value);
-    }
-    if (PyString_Check(value)) {
-        char *str;
-        Py_ssize_t len;
-        PyBytes_AsStringAndSize(value, &str, &len);
-        Local<ArrayBuffer> js_value = ArrayBuffer::New(isolate, len);
-        memcpy(str, js_value->GetContents().Data(), len);
+    if (PyUnicode_Check(value) && PyUnicode_READY(value) == 0) {
+        // Latin-1 and UCS-2 strings have the same layout as V8's one-byte
+        // and two-byte strings.
+        Py_ssize_t len = PyUnicode_GET_LENGTH(value);
+        Local<String> js_value;
+        switch (PyUnicode_KIND(value)) {
+            case PyUnicode_1BYTE_KIND:
+                js_value = js_from_latin1(isolate, value, PyUnicode_1BYTE_DATA(value), len);
+                break;
+            case PyUnicode_2BYTE_KIND:
+                js_value = js_from_utf16(isolate, value, (const uint16_t *) PyUnicode_2BYTE_DATA(value), len);
+                break;
+            default:
+                js_value = js_from_ucs4(isolate, (const uint32_t *) PyUnicode_4BYTE_DATA(value), len);
+                break;
+        }
         return hs.Escape(js_value);
     }
 #else
     if (PyUnicode_Check(value)) {
-        PyObject *value_encoded = PyUnicode_EncodeUTF8(PyUnicode_AS_UNICODE(value), PyUnicode_GET_SIZE(value), NULL);
-        Local<String> js_value = String::NewFromUtf8(isolate, PyString_AS_STRING(value_encoded), NewStringType::kNormal, PyString_GET_SIZE(value_encoded)).ToLocalChecked();
-        Py_DECREF(value_encoded);
+#if Py_UNICODE_SIZE == 2
+        Local<String> js_value = js_from_utf16(isolate, value, (const uint16_t *) PyUnicode_AS_UNICODE(value),
+                PyUnicode_GET_SIZE(value));
+#else
+        Local<String> js_value = js_from_ucs4(isolate, (const uint32_t *) PyUnicode_AS_UNICODE(value), PyUnicode_GET_SIZE(value));
+#endif
         return hs.Escape(js_value);
     } 
     if (PyString_Check(value)) {
-        Local<String> js_value = String::NewFromUtf8(isolate, PyString_AS_STRING(value), NewStringType::kNormal, PyString_GET_SIZE(value)).ToLocalChecked();
+        // V8's UTF-8 decoder is a lot slower than a copy, and most strs are ASCII
+        const uint8_t *str = (const uint8_t *) PyString_AS_STRING(value);
+        Py_ssize_t len = PyString_GET_SIZE(value);
+        Local<String> js_value;
+        if (latin1_is_ascii(str, len)) {
+            js_value = js_from_latin1(isolate, value, str, len);
+        } else {
+            js_value = String::NewFromUtf8(isolate, (const char *) str, NewStringType::kNormal, len).ToLocalChecked();
+        }
         return hs.Escape(js_value);
     }
 #endif
 
+    // JSBuffers export buffers, but they're JavaScript objects already
+    if (PyObject_TypeCheck(value, &js_object_type)) {
+        js_object *py_value = (js_object *) value;
+        if (py_value->py_isolate->isolate != isolate) {
+            isolate->ThrowException(Exception::TypeError(JSTR("Object belongs to a different isolate")));
+            return hs.Escape(Undefined(isolate));
+        }
+        return hs.Escape(py_value->object.Get(isolate));
+    }
+
+    if (PyObject_TypeCheck(value, &live_type)) {
+        return hs.Escape(js_live_from_py(((live_c *) value)->object, context));
+    }
+
+    if (PyObject_TypeCheck(value, &buffer_copy_type)) {
+        Local<ArrayBuffer> js_value = js_array_buffer_from_py(((buffer_copy_c *) value)->object, true, context);
+        if (!js_value.IsEmpty()) {
+            return hs.Escape(js_value);
+        }
+    }
+    // floats and ints from numpy and friends can export buffers too, but
+    // they're numbers first
+    if (PyObject_CheckBuffer(value) && !PyFloat_Check(value) && !PyLong_Check(value)) {
+        Local<ArrayBuffer> js_value = js_array_buffer_from_py(value, false, context);
+        if (!js_value.IsEmpty()) {
+            return hs.Escape(js_value);
+        }
+    }
+
     if (PyNumber_Check(value) && !PyInstance_Check(value)) {
         Local<Number> js_value;
         if (PyFloat_Check(value)) {
             js_value = Number::New(isolate, PyFloat_AS_DOUBLE(value));
         } else if (PyLong_Check(value)) {
-            js_value = Integer::New(isolate, PyLong_AsLong(value));
+            js_value = js_from_py_integer(isolate, value);
 #if PY_MAJOR_VERSION < 3
         } else if (PyInt_Check(value)) {
-            js_value = Integer::New(isolate, PyInt_AS_LONG(value));
+            js_value = js_from_py_integer(isolate, value);
 #endif
         } else {
             // TODO make this work right
@@ -192,11 +650,27 @@ Local<Value> js_from_py(PyObject *value, Local<Context> context) {
     if (PyDict_Check(value)) {
         // a context scope is (I think) needed for Object::New to work
         Context::Scope cs(context);
-        Local<Object> js_dict = Object::New(isolate);
-
         PyObject *dict = value;
         PyObject *key, *value;
         Py_ssize_t pos = 0;
+
+        object_shape *shape = object_shape_for(isolate, dict);
+        if (shape != NULL) {
+            Local<Object> js_dict = shape->templ.Get(isolate)->NewInstance(context).ToLocalChecked();
+            size_t i = 0;
+            while (PyDict_Next(dict, &pos, &key, &value)) {
+                Local<Value> js_value = js_from_py(value, context);
+                // unless converting a value changed the dict, the keys line up
+                if (i < shape->keys.size()) {
+                    js_dict->CreateDataProperty(context, shape->keys[i++].Get(isolate), js_value).FromJust();
+                } else {
+                    js_dict->Set(context, js_from_py(key, context), js_value).FromJust();
+                }
+            }
+            return hs.Escape(js_dict);
+        }
+
+        Local<Object> js_dict = Object::New(isolate);
         while (PyDict_Next(dict, &pos, &key, &value)) {
             js_dict->Set(context, js_from_py(key, context), js_from_py(value, context)).FromJust();
         }
@@ -204,15 +678,7 @@ Local<Value> js_from_py(PyObject *value, Local<Context> context) {
     }
 
     if (PyList_Check(value) || PyTuple_Check(value)) {
-        int length = PySequence_Length(value);
-        Local<Array> array = Array::New(isolate, length);
-        for (int i = 0; i < length; i++) {
-            PyObject *item = PySequence_ITEM(value, i);
-            bool set_worked = array->Set(context, i, js_from_py(item, context)).FromJust();
-            assert(set_worked);
-            Py_DECREF(item);
-        }
-        return hs.Escape(array);
+        return hs.Escape(js_array_from_py(isolate, value, context));
     }
 
     if (PyFunction_Check(value) || PyMethod_Check(value)) {
@@ -225,11 +691,6 @@ Local<Value> js_from_py(PyObject *value, Local<Context> context) {
         return hs.Escape(py_class_get_constructor(templ, context));
     }
 
-    if (PyObject_TypeCheck(value, &js_object_type)) {
-        js_object *py_value = (js_object *) value;
-        return hs.Escape(py_value->object.Get(isolate));
-    }
-
     // it's an arbitrary object
     PyObject *type;
     if (PyInstance_Check(value)) {
@@ -4,12 +4,39 @@
 #include <Python.h>
 #include <v8.h>
 
-PyObject *py_from_js(Local<Value> js_value, Local<Context> context);
+// Everything here runs with the isolate already locked and entered, which
+// every way in from Python (IN_V8) and every callback from V8 has done. The
+// conversions only open handle scopes as they recurse, so converting a big
+// structure doesn't take the isolate lock again for every value in it.
+
+// Decodes UTF-16 into the narrowest str that holds it
+PyObject *py_from_utf16(const uint16_t *data, size_t length);
+
+PyObject *py_from_js_string(Local<String> str_value);
+
+// How much of a JavaScript value py_from_js copies. CONVERT_DEEP turns plain
+// objects and arrays into dicts and lists all the way down. CONVERT_SHALLOW
+// does that for the outermost one and leaves whatever objects are in it as
+// JSObjects. CONVERT_PROXY copies nothing and returns a JSMapping or
+// JSSequence view instead, which converts elements (as views) when they're
+// read.
+#define CONVERT_DEEP 0
+#define CONVERT_SHALLOW 1
+#define CONVERT_PROXY 2
+// Returns -1 with a ValueError for anything but "deep", "shallow" or "proxy"
+int convert_policy_from_name(const char *name);
+const char *convert_policy_name(int policy);
+
+PyObject *py_from_js(Local<Value> js_value, Local<Context> context, int policy = CONVERT_DEEP);
 // If any Python exceptions are thrown in the process, they get swallowed.
 // Because they're probably never going to be too serious. Only like
 // MemoryError.
 Local<Value> js_from_py(PyObject *py_value, Local<Context> context);
 
+// Latin-1 and UCS-2 strs (and ASCII strs on Python 2) at least this long get
+// shared with V8 instead of copied. 0 means never.
+PyObject *convert_set_external_string_threshold(PyObject *shit, PyObject *length);
+
 PyObject *pys_from_jss(const FunctionCallbackInfo<Value> &js_args, Local<Context> context);
 // js_args is an out parameter, expected to contain enough space
 void jss_from_pys(PyObject *py_args, Local<Value> *js_args, Local<Context> context);
@@ -1,27 +1,11 @@
 #include <Python.h>
 #include "v8py.h"
 #include <v8.h>
-#if defined(V8_OS_LINUX)
-# include <arpa/inet.h>
-#endif
+#include <vector>
 #include "context.h"
+#include "convert.h"
 #include "debugger.h"
-
-#ifdef _WIN32
-
-// don't want to include Winsock2.h
-uint16_t htons (uint16_t x)
-{
-#if BYTE_ORDER == BIG_ENDIAN
-  return x;
-#elif BYTE_ORDER == LITTLE_ENDIAN
-  return __bswap_16 (x);
-#else
-# error "What kind of system is this?"
-#endif
-}
-
-#endif
+#include "transcode.h"
 
 PyObject *json_from_stringview(const std::unique_ptr<StringBuffer> &message);
 std::unique_ptr<StringBuffer> stringview_from_json(PyObject *json);
@@ -53,12 +37,11 @@ PyObject *debugger_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
 }
 
 int debugger_init(debugger_c *self, PyObject *args, PyObject *kwargs) {
-    IN_V8;
-
     context_c *context;
     if (PyArg_ParseTuple(args, "O", &context) < 0) {
         return -1;
     }
+    IN_V8(context->py_isolate->isolate);
 
     Py_INCREF(context);
     self->context = context;
@@ -69,6 +52,10 @@ int debugger_init(debugger_c *self, PyObject *args, PyObject *kwargs) {
         return NULL;
     }
     context->has_debugger = true;
+    // a new inspector hasn't seen the scripts compiled for the last one
+    PyObject *cleared = PyObject_CallMethod(context->debug_scripts, (char *) "clear", NULL);
+    PyErr_PROPAGATE_(cleared);
+    Py_DECREF(cleared);
 
     self->client = new V8PyInspectorClient(self);
     self->inspector = V8Inspector::create(isolate, self->client);
@@ -89,6 +76,7 @@ void call_self(debugger_c *self, const char *method) {
 }
 
 void V8PyChannel::handle_message(const std::unique_ptr<StringBuffer> &message) {
+    WITH_GIL;
     PyObject *json = json_from_stringview(message);
     if (json == NULL) {
         PyErr_WriteUnraisable((PyObject *) debugger_);
@@ -103,10 +91,12 @@ void V8PyChannel::handle_message(const std::unique_ptr<StringBuffer> &message) {
 }
 
 void V8PyInspectorClient::runMessageLoopOnPause(int context_group_id) {
+    WITH_GIL;
     call_self(debugger_, "run_loop");
 }
 
 void V8PyInspectorClient::quitMessageLoopOnPause() {
+    WITH_GIL;
     call_self(debugger_, "quit_loop");
 }
 
@@ -116,7 +106,7 @@ PyObject *debugger_send(debugger_c *self, PyObject *message) {
         return NULL;
     }
 
-    IN_V8;
+    IN_V8(self->context->py_isolate->isolate);
     std::unique_ptr<StringBuffer> stringview = stringview_from_json(message);
     if (stringview.get() == NULL) return NULL;
     self->session.get()->dispatchProtocolMessage(stringview.get()->string());
@@ -124,7 +114,7 @@ PyObject *debugger_send(debugger_c *self, PyObject *message) {
 }
 
 void debugger_dealloc(debugger_c *self) {
-    IN_V8;
+    IN_V8(self->context->py_isolate->isolate);
     self->session.reset();
     self->inspector.reset();
     delete self->client;
@@ -148,10 +138,12 @@ PyObject *json_from_stringview(const std::unique_ptr<StringBuffer> &message) {
     if (stringview.is8Bit()) {
         string = PyUnicode_DecodeLatin1((const char *) stringview.characters8(), stringview.length(), NULL);
     } else {
-        string = PyUnicode_DecodeUTF16((const char *) stringview.characters16(), stringview.length() * 2, NULL, NULL);
+        string = py_from_utf16(stringview.characters16(), stringview.length());
     }
     PyErr_PROPAGATE(string);
-    return PyObject_CallFunctionObjArgs(loads, string, NULL);
+    PyObject *json = PyObject_CallFunctionObjArgs(loads, string, NULL);
+    Py_DECREF(string);
+    return json;
 }
 
 std::unique_ptr<StringBuffer> stringview_from_json(PyObject *json) {
@@ -165,21 +157,32 @@ std::unique_ptr<StringBuffer> stringview_from_json(PyObject *json) {
 
     PyObject *string = PyObject_CallFunctionObjArgs(dumps, json, NULL);
     PyErr_PROPAGATE(string);
-#if PY_MAJOR_VERSION < 3
-    PyObject *message_unicode = PyUnicode_DecodeASCII(
-            PyString_AS_STRING(string), PyString_GET_SIZE(string), NULL);
-    PyErr_PROPAGATE(message_unicode);
-    Py_DECREF(string);
-    string = message_unicode;
+    // json.dumps escapes everything outside ASCII by default, so this is
+    // almost always a one-byte string
+    std::unique_ptr<StringBuffer> buffer;
+#if PY_MAJOR_VERSION >= 3
+    if (PyUnicode_READY(string) < 0) {
+        Py_DECREF(string);
+        return NULL;
+    }
+    Py_ssize_t length = PyUnicode_GET_LENGTH(string);
+    switch (PyUnicode_KIND(string)) {
+        case PyUnicode_1BYTE_KIND:
+            buffer = StringBuffer::create(StringView(PyUnicode_1BYTE_DATA(string), length));
+            break;
+        case PyUnicode_2BYTE_KIND:
+            buffer = StringBuffer::create(StringView((const uint16_t *) PyUnicode_2BYTE_DATA(string), length));
+            break;
+        default: {
+            std::vector<uint16_t> utf16(length * 2);
+            size_t utf16_length = ucs4_to_utf16((const uint32_t *) PyUnicode_4BYTE_DATA(string), length, utf16.data());
+            buffer = StringBuffer::create(StringView(utf16.data(), utf16_length));
+            break;
+        }
+    }
+#else
+    buffer = StringBuffer::create(StringView((const uint8_t *) PyString_AS_STRING(string), PyString_GET_SIZE(string)));
 #endif
-    int endian = htons(1) == 1? 1 : -1;
-    PyObject *utf16_bytes = PyUnicode_EncodeUTF16(
-            PyUnicode_AS_UNICODE(string), 
-            PyUnicode_GET_SIZE(string), 
-            NULL, endian);
-    PyErr_PROPAGATE(utf16_bytes);
     Py_DECREF(string);
-    const uint16_t *command_bytes = (const uint16_t *) PyString_AS_STRING(utf16_bytes);
-    int length = PyString_GET_SIZE(utf16_bytes)/2; // it wants the number of characters, not the number of bytes
-    return StringBuffer::create(StringView(command_bytes, length));
+    return buffer;
 }
@@ -36,7 +36,7 @@ class V8PyInspectorClient : public V8InspectorClient {
         V8PyInspectorClient(debugger_c *debugger) : debugger_(debugger) {}
         Local<Context> ensureDefaultContextInGroup(int context_group_id) override {
             printf("returning context\n");
-            return debugger_->context->js_context.Get(isolate);
+            return debugger_->context->js_context.Get(debugger_->context->py_isolate->isolate);
         }
 
         void runMessageLoopOnPause(int context_group_id) override;
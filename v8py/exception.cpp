@@ -26,10 +26,13 @@ int js_exception_type_init() {
 }
 
 PyObject *js_exception_new(Local<Value> exception, Local<Message> message) {
+    CURRENT_ISOLATE;
     HandleScope hs(isolate);
     Local<Context> no_ctx;
     js_exception *self = (js_exception *) js_exception_type.tp_alloc(&js_exception_type, 0);
     PyErr_PROPAGATE(self);
+    self->py_isolate = isolate_get_object(isolate);
+    Py_INCREF(self->py_isolate);
     self->exception.Reset(isolate, exception);
     self->message.Reset(isolate, message);
 
@@ -46,15 +49,20 @@ PyObject *js_exception_new(Local<Value> exception, Local<Message> message) {
 }
 
 PyObject *js_exception_get_value(js_exception *self, void *shit) {
-    IN_V8;
+    IN_V8(self->py_isolate->isolate);
     Local<Context> no_ctx;
     return py_from_js(self->exception.Get(isolate), no_ctx);
 }
 
 void js_exception_dealloc(js_exception *self) {
-    self->exception.Reset();
-    self->message.Reset();
+    isolate_c *py_isolate = self->py_isolate;
+    if (py_isolate != NULL) {
+        IsolateLocker locker(py_isolate->isolate);
+        self->exception.Reset();
+        self->message.Reset();
+    }
     Py_TYPE(self)->tp_free((PyObject *) self);
+    Py_XDECREF(py_isolate);
 }
 
 PyTypeObject js_terminated_type = {
@@ -77,6 +85,7 @@ extern "C" {
 }
 
 void py_throw_js(Local<Value> js_exc, Local<Message> js_message) {
+    CURRENT_ISOLATE;
     if (js_exc->IsObject() && js_exc.As<Object>()->InternalFieldCount() == OBJECT_INTERNAL_FIELDS) {
         Local<Object> exc_object = js_exc.As<Object>();
         PyObject *exc_type = (PyObject *) exc_object->GetInternalField(2).As<External>()->Value();
@@ -112,7 +121,7 @@ void py_throw_js(Local<Value> js_exc, Local<Message> js_message) {
             js_func_name->WriteUtf8(func_name);
         }
 
-        PyObject *script_name_unicode = construct_script_name(stack_frame->GetScriptName(), stack_frame->GetScriptId());
+        PyObject *script_name_unicode = construct_script_name(isolate, stack_frame->GetScriptName(), stack_frame->GetScriptId());
         if (script_name_unicode == NULL) return;
         PyObject *script_name_string = PyUnicode_AsUTF8String(script_name_unicode);
         if (script_name_string == NULL) return;
@@ -146,6 +155,7 @@ void py_throw_js(Local<Value> js_exc, Local<Message> js_message) {
 }
 
 void js_throw_py() {
+    CURRENT_ISOLATE;
     Local<Context> context = isolate->GetCurrentContext();
     PyObject *exc_type, *exc_value, *exc_traceback;
     PyErr_Fetch(&exc_type, &exc_value, &exc_traceback);
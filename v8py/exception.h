@@ -4,12 +4,15 @@
 #include <Python.h>
 #include <v8.h>
 
+#include "isolate.h"
+
 using namespace v8;
 
 typedef struct {
     PyBaseExceptionObject base;
     Persistent<Value> exception;
     Persistent<Message> message;
+    isolate_c *py_isolate;
 } js_exception;
 extern PyTypeObject js_exception_type;
 int js_exception_type_init();
@@ -53,7 +53,8 @@ void greenstack_actually_switch(void *data) {
 }
 
 void greenstack_switch_v8(void *data) {
-    if (Locker::IsLocked(isolate)) {
+    Isolate *isolate = Isolate::GetCurrent();
+    if (isolate != NULL && Locker::IsLocked(isolate)) {
         Unlocker unlocker(isolate);
         return greenstack_actually_switch(data);
     }
@@ -0,0 +1,258 @@
+#include <Python.h>
+#include "v8py.h"
+#include <v8.h>
+#include <thread>
+
+#include "isolate.h"
+#include "snapshot.h"
+#include "names.h"
+
+using namespace v8;
+
+isolate_c *default_isolate = NULL;
+static int next_index = 0;
+ArrayBuffer::Allocator *array_buffer_allocator = NULL;
+
+PyGetSetDef isolate_getset[] = {
+    {(char *) "contexts", (getter) isolate_get_contexts, NULL, NULL, NULL},
+    {(char *) "index", (getter) isolate_get_index, NULL, NULL, NULL},
+    {(char *) "has_snapshot", (getter) isolate_get_has_snapshot, NULL, NULL, NULL},
+    {NULL},
+};
+PyTypeObject isolate_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+int isolate_type_init() {
+    isolate_type.tp_name = "v8py.Isolate";
+    isolate_type.tp_basicsize = sizeof(isolate_c);
+    isolate_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    isolate_type.tp_doc = "";
+    isolate_type.tp_new = (newfunc) isolate_new;
+    isolate_type.tp_dealloc = (destructor) isolate_dealloc;
+    isolate_type.tp_getset = isolate_getset;
+    if (PyType_Ready(&isolate_type) < 0) return -1;
+
+    default_isolate = isolate_create();
+    if (default_isolate == NULL) return -1;
+    return 0;
+}
+
+isolate_c *isolate_create(PyObject *snapshot_blob) {
+    if (array_buffer_allocator == NULL) {
+        array_buffer_allocator = ArrayBuffer::Allocator::NewDefaultAllocator();
+    }
+
+    isolate_c *self = (isolate_c *) isolate_type.tp_alloc(&isolate_type, 0);
+    PyErr_PROPAGATE(self);
+    self->index = next_index++;
+    self->contexts = 0;
+    self->deadlines = NULL;
+    self->gil_released = 0;
+    self->snapshot_blob = NULL;
+    self->class_templates = PyDict_New();
+    self->function_templates = PyDict_New();
+    self->object_shapes = PyDict_New();
+    if (self->class_templates == NULL || self->function_templates == NULL || self->object_shapes == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+
+    Isolate::CreateParams create_params;
+    create_params.array_buffer_allocator = array_buffer_allocator;
+    if (snapshot_blob != NULL) {
+        create_params.external_references = snapshot_external_references;
+        Py_INCREF(snapshot_blob);
+        self->snapshot_blob = snapshot_blob;
+        self->startup_data.data = PyBytes_AS_STRING(snapshot_blob);
+        self->startup_data.raw_size = (int) PyBytes_GET_SIZE(snapshot_blob);
+        create_params.snapshot_blob = &self->startup_data;
+    }
+    self->isolate = Isolate::New(create_params);
+    self->isolate->SetData(ISOLATE_OBJECT_SLOT, self);
+    self->isolate->SetCaptureStackTraceForUncaughtExceptions(true, 100,
+            // sadly the v8 people screwed up and require me to cast this into to an enum
+            static_cast<StackTrace::StackTraceOptions>(StackTrace::kOverview | StackTrace::kScriptId));
+
+    self->names = new NameCache(self->isolate);
+
+    {
+        IN_V8(self->isolate);
+        self->compile_context.Reset(isolate, Context::New(isolate));
+    }
+    create_memes_plz_thx(self);
+    return self;
+}
+
+PyObject *isolate_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = {"snapshot", NULL};
+    PyObject *snapshot = Py_None;
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "|O", (char **) keywords, &snapshot) < 0) {
+        return NULL;
+    }
+    if (snapshot == Py_None) {
+        return (PyObject *) isolate_create();
+    }
+    if (!PyObject_TypeCheck(snapshot, &snapshot_type)) {
+        PyErr_SetString(PyExc_TypeError, "snapshot must be a Snapshot or None");
+        return NULL;
+    }
+    return (PyObject *) isolate_create(((snapshot_c *) snapshot)->blob);
+}
+
+void isolate_dealloc(isolate_c *self) {
+    if (self->isolate != NULL) {
+        {
+            IN_V8(self->isolate);
+            self->compile_context.Reset();
+            delete self->names;
+            self->live_dict_template.Reset();
+            self->live_list_template.Reset();
+#define RESET_MEME(name, string) self->name##p.Reset();
+            MAGIC_CONSTANT_STRING_LIST_KAPPA(RESET_MEME)
+#undef RESET_MEME
+        }
+        // templates are only ever referenced from these dicts, so after this
+        // nothing will touch the isolate again
+        Py_CLEAR(self->class_templates);
+        Py_CLEAR(self->function_templates);
+        Py_CLEAR(self->object_shapes);
+        self->isolate->Dispose();
+    }
+    Py_XDECREF(self->class_templates);
+    Py_XDECREF(self->function_templates);
+    Py_XDECREF(self->object_shapes);
+    Py_XDECREF(self->snapshot_blob);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+PyObject *isolate_get_contexts(isolate_c *self, void *shit) {
+    return PyLong_FromSsize_t(self->contexts);
+}
+
+PyObject *isolate_get_index(isolate_c *self, void *shit) {
+    return PyLong_FromLong(self->index);
+}
+
+PyObject *isolate_get_has_snapshot(isolate_c *self, void *shit) {
+    return PyBool_FromLong(self->snapshot_blob != NULL);
+}
+
+PyMethodDef isolate_pool_methods[] = {
+    {"acquire", (PyCFunction) isolate_pool_acquire, METH_NOARGS, NULL},
+    {NULL},
+};
+PySequenceMethods isolate_pool_sequence = {
+    (lenfunc) isolate_pool_length, NULL, NULL, (ssizeargfunc) isolate_pool_getitem
+};
+PyTypeObject isolate_pool_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+int isolate_pool_type_init() {
+    isolate_pool_type.tp_name = "v8py.IsolatePool";
+    isolate_pool_type.tp_basicsize = sizeof(isolate_pool_c);
+    isolate_pool_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    isolate_pool_type.tp_doc = "";
+    isolate_pool_type.tp_new = (newfunc) isolate_pool_new;
+    isolate_pool_type.tp_dealloc = (destructor) isolate_pool_dealloc;
+    isolate_pool_type.tp_methods = isolate_pool_methods;
+    isolate_pool_type.tp_as_sequence = &isolate_pool_sequence;
+    return PyType_Ready(&isolate_pool_type);
+}
+
+PyObject *isolate_pool_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    int size = (int) std::thread::hardware_concurrency();
+    const char *placement = "round_robin";
+    static const char *keywords[] = {"size", "placement", NULL};
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "|is", (char **) keywords, &size, &placement) < 0) {
+        return NULL;
+    }
+    if (size <= 0) {
+        size = 1;
+    }
+
+    int placement_mode;
+    if (strcmp(placement, "round_robin") == 0) {
+        placement_mode = PLACEMENT_ROUND_ROBIN;
+    } else if (strcmp(placement, "least_loaded") == 0) {
+        placement_mode = PLACEMENT_LEAST_LOADED;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "placement must be 'round_robin' or 'least_loaded'");
+        return NULL;
+    }
+
+    PyObject *isolates = PyTuple_New(size);
+    PyErr_PROPAGATE(isolates);
+    for (int i = 0; i < size; i++) {
+        isolate_c *isolate = isolate_create();
+        if (isolate == NULL) {
+            Py_DECREF(isolates);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(isolates, i, (PyObject *) isolate);
+    }
+
+    isolate_pool_c *self = (isolate_pool_c *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        Py_DECREF(isolates);
+        return NULL;
+    }
+    self->isolates = isolates;
+    self->placement = placement_mode;
+    self->next = 0;
+    return (PyObject *) self;
+}
+
+void isolate_pool_dealloc(isolate_pool_c *self) {
+    Py_DECREF(self->isolates);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+PyObject *isolate_pool_acquire(isolate_pool_c *self) {
+    Py_ssize_t size = PyTuple_GET_SIZE(self->isolates);
+    PyObject *chosen;
+    if (self->placement == PLACEMENT_LEAST_LOADED) {
+        isolate_c *best = (isolate_c *) PyTuple_GET_ITEM(self->isolates, 0);
+        for (Py_ssize_t i = 1; i < size; i++) {
+            isolate_c *candidate = (isolate_c *) PyTuple_GET_ITEM(self->isolates, i);
+            if (candidate->contexts < best->contexts) {
+                best = candidate;
+            }
+        }
+        chosen = (PyObject *) best;
+    } else {
+        chosen = PyTuple_GET_ITEM(self->isolates, self->next);
+        self->next = (self->next + 1) % size;
+    }
+    Py_INCREF(chosen);
+    return chosen;
+}
+
+Py_ssize_t isolate_pool_length(isolate_pool_c *self) {
+    return PyTuple_GET_SIZE(self->isolates);
+}
+
+PyObject *isolate_pool_getitem(isolate_pool_c *self, Py_ssize_t i) {
+    if (i < 0 || i >= PyTuple_GET_SIZE(self->isolates)) {
+        PyErr_SetString(PyExc_IndexError, "isolate index out of range");
+        return NULL;
+    }
+    PyObject *item = PyTuple_GET_ITEM(self->isolates, i);
+    Py_INCREF(item);
+    return item;
+}
+
+isolate_c *isolate_choose(PyObject *spec) {
+    if (spec == NULL || spec == Py_None) {
+        Py_INCREF(default_isolate);
+        return default_isolate;
+    }
+    if (PyObject_TypeCheck(spec, &isolate_type)) {
+        Py_INCREF(spec);
+        return (isolate_c *) spec;
+    }
+    if (PyObject_TypeCheck(spec, &isolate_pool_type)) {
+        return (isolate_c *) isolate_pool_acquire((isolate_pool_c *) spec);
+    }
+    PyErr_SetString(PyExc_TypeError, "isolate must be an Isolate, an IsolatePool or None");
+    return NULL;
+}
@@ -0,0 +1,90 @@
+#ifndef ISOLATE_H
+#define ISOLATE_H
+
+#include <Python.h>
+#include <v8.h>
+
+#include "kappa.h"
+
+using namespace v8;
+
+class Deadline;
+class NameCache;
+
+// An Isolate owns a V8 heap and everything that can't be shared between
+// heaps: function templates for exposed Python classes and functions, the
+// magic strings, and the context scripts get compiled in. Every Context and
+// Script is bound to one isolate when it is created.
+typedef struct isolate_c_ {
+    PyObject_HEAD
+    Isolate *isolate;
+    int index;
+    // number of live contexts bound to this isolate, used for placement
+    Py_ssize_t contexts;
+    // top of the stack of armed deadlines, see watchdog.h
+    Deadline *deadlines;
+    // threads that hold or wait for the isolate with the GIL released, see
+    // IsolateLocker. Only touched with the GIL held.
+    int gil_released;
+    Persistent<Context> compile_context;
+    // the snapshot blob the isolate started from, which has to outlive it
+    PyObject *snapshot_blob;
+    StartupData startup_data;
+    PyObject *class_templates;
+    PyObject *function_templates;
+    // dict key tuple -> capsule of an object_shape, see convert.cpp
+    PyObject *object_shapes;
+    NameCache *names;
+    // for live dicts and lists, see live.cpp
+    Persistent<ObjectTemplate> live_dict_template;
+    Persistent<ObjectTemplate> live_list_template;
+#define DECLARE_MAGIC(name, string) Persistent<String> name##p;
+    MAGIC_CONSTANT_STRING_LIST_KAPPA(DECLARE_MAGIC)
+#undef DECLARE_MAGIC
+} isolate_c;
+extern PyTypeObject isolate_type;
+int isolate_type_init();
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *isolates;
+    int placement;
+    Py_ssize_t next;
+} isolate_pool_c;
+extern PyTypeObject isolate_pool_type;
+int isolate_pool_type_init();
+
+#define PLACEMENT_ROUND_ROBIN 0
+#define PLACEMENT_LEAST_LOADED 1
+
+// Isolate data slots
+#define ISOLATE_OBJECT_SLOT 0
+
+extern isolate_c *default_isolate;
+// shared by every isolate, so anything that takes over an ArrayBuffer's
+// memory frees it with this
+extern ArrayBuffer::Allocator *array_buffer_allocator;
+
+// snapshot_blob is the bytes of a Snapshot, or NULL for a blank isolate
+isolate_c *isolate_create(PyObject *snapshot_blob = NULL);
+PyObject *isolate_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void isolate_dealloc(isolate_c *self);
+PyObject *isolate_get_contexts(isolate_c *self, void *shit);
+PyObject *isolate_get_index(isolate_c *self, void *shit);
+PyObject *isolate_get_has_snapshot(isolate_c *self, void *shit);
+
+PyObject *isolate_pool_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void isolate_pool_dealloc(isolate_pool_c *self);
+PyObject *isolate_pool_acquire(isolate_pool_c *self);
+Py_ssize_t isolate_pool_length(isolate_pool_c *self);
+PyObject *isolate_pool_getitem(isolate_pool_c *self, Py_ssize_t i);
+
+// Picks an isolate from None (the default isolate), an Isolate, or an
+// IsolatePool. Returns a new reference.
+isolate_c *isolate_choose(PyObject *spec);
+
+inline isolate_c *isolate_get_object(Isolate *isolate) {
+    return (isolate_c *) isolate->GetData(ISOLATE_OBJECT_SLOT);
+}
+
+#endif
@@ -23,11 +23,29 @@ int js_function_type_init() {
 }
 
 PyObject *js_function_call(js_function *self, PyObject *args, PyObject *kwargs) {
-    IN_V8;
+    // JavaScript doesn't have keyword arguments, so the only one is for us
+    const char *convert = NULL;
+    if (kwargs != NULL) {
+        static const char *keywords[] = {"convert", NULL};
+        PyObject *no_args = PyTuple_New(0);
+        PyErr_PROPAGATE(no_args);
+        int parsed = PyArg_ParseTupleAndKeywords(no_args, kwargs, "|z", (char **) keywords, &convert);
+        Py_DECREF(no_args);
+        if (!parsed) {
+            return NULL;
+        }
+    }
+
+    IN_V8(self->py_isolate->isolate);
     Local<Object> object = self->object.Get(isolate);
     IN_CONTEXT(object->CreationContext());
     JS_TRY
 
+    int convert_policy = context_convert_policy(context, convert);
+    if (convert_policy < 0) {
+        return NULL;
+    }
+
     Local<Value> js_this;
     if (self->js_this.IsEmpty()) {
         js_this = Undefined(isolate);
@@ -37,28 +55,30 @@ PyObject *js_function_call(js_function *self, PyObject *args, PyObject *kwargs)
     int argc = PyTuple_GET_SIZE(args);
     MaybeLocal<Value> result;
 
-    if (!context_setup_timeout(context)) return NULL;
+    CONTEXT_DEADLINE(context);
 #ifndef _WIN32
     // error C2131: expression did not evaluate to a constant on Windows
     if (argc <= 16) {
         Local<Value> argv[argc];
         jss_from_pys(args, &argv[0], context);
-        result = object->CallAsFunction(context, js_this, argc, &argv[0]);
+        CONTEXT_RUN(context, result = object->CallAsFunction(context, js_this, argc, &argv[0]));
     } else {
 #endif
         Local<Value> *argv = new Local<Value>[argc];
         jss_from_pys(args, argv, context);
-        result = object->CallAsFunction(context, js_this, argc, argv);
+        CONTEXT_RUN(context, result = object->CallAsFunction(context, js_this, argc, argv));
         delete[] argv;
 #ifndef _WIN32
     }
 #endif
-    if (!context_cleanup_timeout(context)) return NULL;
     PY_PROPAGATE_JS;
-    return py_from_js(result.ToLocalChecked(), context);
+    return py_from_js(result.ToLocalChecked(), context, convert_policy);
 }
 
 void js_function_dealloc(js_function *self) {
-    self->js_this.Reset();
+    if (self->py_isolate != NULL) {
+        IsolateLocker locker(self->py_isolate->isolate);
+        self->js_this.Reset();
+    }
     js_object_dealloc((js_object *) self);
 }
@@ -5,6 +5,8 @@
 #include "convert.h"
 #include "jsobject.h"
 #include "context.h"
+#include "buffer.h"
+#include "names.h"
 
 using namespace v8;
 
@@ -47,25 +49,35 @@ int js_promise_type_init() {
     return PyType_Ready(&js_promise_type);
 }
 
-js_object *js_object_new(Local<Object> object, Local<Context> context) {
-    IN_V8;
-    Context::Scope cs(context);
-    js_object *self;
+static PyTypeObject *js_object_subtype(Local<Object> object) {
     if (object->IsPromise()) {
-        self = (js_object *) js_promise_type.tp_alloc(&js_promise_type, 0);
-    } else if (object->IsCallable()) {
-        self = (js_object *) js_function_type.tp_alloc(&js_function_type, 0);
-    } else {
-        self = (js_object *) js_object_type.tp_alloc(&js_object_type, 0);
+        return &js_promise_type;
+    }
+    if (object->IsCallable()) {
+        return &js_function_type;
+    }
+    if (js_object_is_buffer(object)) {
+        return &js_buffer_type;
     }
+    return &js_object_type;
+}
+
+js_object *js_object_new(Local<Object> object, Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
+    USING_V8;
+    PyTypeObject *type = js_object_subtype(object);
+    js_object *self = (js_object *) type->tp_alloc(type, 0);
 
     if (self != NULL) {
         self->object.Reset(isolate, object);
+        self->py_isolate = isolate_get_object(isolate);
+        Py_INCREF(self->py_isolate);
     }
     return self;
 }
 
 void js_object_weak_callback(const WeakCallbackInfo<js_object> &info) {
+    WITH_GIL;
     js_object *self = info.GetParameter();
     self->object.Reset();
 
@@ -73,20 +85,15 @@ void js_object_weak_callback(const WeakCallbackInfo<js_object> &info) {
 }
 
 js_object *js_object_weak_new(Local<Object> object, Local<Context> context) {
-    IN_V8;
-    Context::Scope cs(context);
-    js_object *self;
-    if (object->IsPromise()) {
-        self = (js_object *) js_promise_type.tp_alloc(&js_promise_type, 0);
-    } else if (object->IsCallable()) {
-        self = (js_object *) js_function_type.tp_alloc(&js_function_type, 0);
-    } else {
-        self = (js_object *) js_object_type.tp_alloc(&js_object_type, 0);
-    }
-
+    Isolate *isolate = context->GetIsolate();
+    USING_V8;
+    PyTypeObject *type = js_object_subtype(object);
+    js_object *self = (js_object *) type->tp_alloc(type, 0);
 
     if (self != NULL) {
         self->object.Reset(isolate, object);
+        self->py_isolate = isolate_get_object(isolate);
+        Py_INCREF(self->py_isolate);
         self->object.SetWeak(self, js_object_weak_callback, WeakCallbackType::kFinalizer);
     }
     return self;
@@ -96,12 +103,12 @@ PyObject *js_object_getattro(js_object *self, PyObject *name) {
     if (PyObject_GenericHasAttr((PyObject *) self, name)) {
         return PyObject_GenericGetAttr((PyObject *) self, name);
     }
-    IN_V8;
+    IN_V8(self->py_isolate->isolate);
     Local<Object> object = self->object.Get(isolate);
     IN_CONTEXT(object->CreationContext());
-    Local<Value> js_name = js_from_py(name, context);
+    Local<Value> js_name = self->py_isolate->names->js_name(name, context);
     JS_TRY
-    if (!context_setup_timeout(context)) return NULL;
+    CONTEXT_DEADLINE(context);
     if (!object->Has(context, js_name).FromJust()) {
         // TODO fix this so that it works
         PyObject *class_name = py_from_js(object->GetConstructorName(), context);
@@ -122,8 +129,6 @@ PyObject *js_object_getattro(js_object *self, PyObject *name) {
     PY_PROPAGATE_JS;
 
     MaybeLocal<Value> js_value = object->Get(context, js_name);
-    if (!context_cleanup_timeout(context)) return NULL;
-
     PY_PROPAGATE_JS;
     PyObject *value = py_from_js(js_value.ToLocalChecked(), context);
     PyErr_PROPAGATE(value);
@@ -141,20 +146,19 @@ int js_object_setattro(js_object *self, PyObject *name, PyObject *value) {
         return PyObject_GenericSetAttr((PyObject *) self, name, value);
     }
 
-    IN_V8;
+    IN_V8(self->py_isolate->isolate);
     Local<Object> object = self->object.Get(isolate);
     IN_CONTEXT(object->CreationContext());
     JS_TRY
 
 
-    if (!context_setup_timeout(context)) return -1;
+    CONTEXT_DEADLINE(context);
 
+    Local<Value> js_name = self->py_isolate->names->js_name(name, context);
     if (value != NULL)
-        object->Set(context, js_from_py(name, context), js_from_py(value, context));
+        object->Set(context, js_name, js_from_py(value, context));
     else
-        object->Delete(context, js_from_py(name, context));
-
-    if (!context_cleanup_timeout(context)) return -1;
+        object->Delete(context, js_name);
 
     PY_PROPAGATE_JS_RET(-1);
     return 0;
@@ -169,7 +173,7 @@ PyObject *js_object_getiter(js_object *self) {
 }
 
 PyObject *js_object_dir(js_object *self) {
-    IN_V8;
+    IN_V8(self->py_isolate->isolate);
     Local<Object> object = self->object.Get(isolate);
     Local<Context> context = object->CreationContext();
     Context::Scope cs(context);
@@ -181,7 +185,7 @@ PyObject *js_object_dir(js_object *self) {
     PyObject *py_properties = PyList_New(properties->Length());
     PyErr_PROPAGATE(py_properties);
 
-    if (!context_setup_timeout(context)) return NULL;
+    CONTEXT_DEADLINE(context);
     for (unsigned i = 0; i < properties->Length(); i++) {
         MaybeLocal<Value> js_property = properties->Get(context, i);
         PY_PROPAGATE_JS;
@@ -189,13 +193,11 @@ PyObject *js_object_dir(js_object *self) {
         PyList_SET_ITEM(py_properties, i, py_property);
     }
 
-    if (!context_cleanup_timeout(context)) return NULL;
-
     return py_properties;
 }
 
 PyObject *js_object_repr(js_object *self) {
-    IN_V8;
+    IN_V8(self->py_isolate->isolate);
     Local<Object> object = self->object.Get(isolate);
     Local<Context> context = object->CreationContext();
     Context::Scope cs(context);
@@ -204,8 +206,13 @@ PyObject *js_object_repr(js_object *self) {
 }
 
 void js_object_dealloc(js_object *self) {
-    self->object.Reset();
+    isolate_c *py_isolate = self->py_isolate;
+    if (py_isolate != NULL) {
+        IsolateLocker locker(py_isolate->isolate);
+        self->object.Reset();
+    }
     Py_TYPE(self)->tp_free((PyObject *) self);
+    Py_XDECREF(py_isolate);
 }
 
 void js_promise_dealloc(js_promise *self) {
@@ -4,15 +4,20 @@
 #include <Python.h>
 #include <v8.h>
 
+#include "isolate.h"
+
 using namespace v8;
 
 typedef struct {
     PyObject_HEAD
     Persistent<Object> object;
+    isolate_c *py_isolate;
 } js_object;
 extern PyTypeObject js_object_type;
 int js_object_type_init();
 
+// Both expect the isolate to be locked already, they're only called while
+// converting values
 js_object *js_object_new(Local<Object> object, Local<Context> context);
 js_object *js_object_weak_new(Local<Object> object, Local<Context> context);
 PyObject *js_object_fake_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
@@ -28,6 +33,7 @@ PyObject *js_object_repr(js_object *self);
 typedef struct {
     PyObject_HEAD
     Persistent<Object> object;
+    isolate_c *py_isolate;
     Persistent<Value> js_this;
 } js_function;
 extern PyTypeObject js_function_type;
@@ -40,11 +46,41 @@ void js_function_dealloc(js_function *self);
 typedef struct {
     PyObject_HEAD
     Persistent<Object> object;
+    isolate_c *py_isolate;
 } js_promise;
 extern PyTypeObject js_promise_type;
 int js_promise_type_init();
 
 void js_promise_dealloc(js_promise *self);
 
+// Views on plain objects and arrays returned with CONVERT_PROXY, see
+// jsview.cpp. They're JSObjects underneath, so passing one back to
+// JavaScript passes the original object.
+extern PyTypeObject js_mapping_type;
+int js_mapping_type_init();
+extern PyTypeObject js_sequence_type;
+int js_sequence_type_init();
+
+js_object *js_mapping_new(Local<Object> object, Local<Context> context);
+js_object *js_sequence_new(Local<Array> array, Local<Context> context);
+
+Py_ssize_t js_mapping_length(js_object *self);
+PyObject *js_mapping_getitem(js_object *self, PyObject *key);
+int js_mapping_setitem(js_object *self, PyObject *key, PyObject *value);
+int js_mapping_contains(js_object *self, PyObject *key);
+PyObject *js_mapping_getiter(js_object *self);
+PyObject *js_mapping_keys(js_object *self);
+PyObject *js_mapping_values(js_object *self);
+PyObject *js_mapping_items(js_object *self);
+PyObject *js_mapping_get(js_object *self, PyObject *args);
+
+Py_ssize_t js_sequence_length(js_object *self);
+PyObject *js_sequence_item(js_object *self, Py_ssize_t index);
+PyObject *js_sequence_getitem(js_object *self, PyObject *key);
+int js_sequence_setitem(js_object *self, PyObject *key, PyObject *value);
+PyObject *js_sequence_getiter(js_object *self);
+
+PyObject *js_view_richcompare(js_object *self, PyObject *other, int op);
+
 
 #endif
@@ -0,0 +1,385 @@
+#include <Python.h>
+#include "v8py.h"
+#include <v8.h>
+
+#include "convert.h"
+#include "jsobject.h"
+#include "context.h"
+#include "names.h"
+
+using namespace v8;
+
+// The views hold on to the object like any JSObject and only convert what
+// gets read, so a huge result costs the same to return as a small one. They
+// don't do attribute access on the JavaScript object, same as a dict.
+
+PyMethodDef js_mapping_methods[] = {
+    {"keys", (PyCFunction) js_mapping_keys, METH_NOARGS, NULL},
+    {"values", (PyCFunction) js_mapping_values, METH_NOARGS, NULL},
+    {"items", (PyCFunction) js_mapping_items, METH_NOARGS, NULL},
+    {"get", (PyCFunction) js_mapping_get, METH_VARARGS, NULL},
+    {NULL},
+};
+PyMappingMethods js_mapping_mapping_methods = {
+    (lenfunc) js_mapping_length, (binaryfunc) js_mapping_getitem, (objobjargproc) js_mapping_setitem
+};
+PySequenceMethods js_mapping_sequence_methods = {
+    NULL, NULL, NULL, NULL, NULL, NULL, NULL, (objobjproc) js_mapping_contains
+};
+PyTypeObject js_mapping_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+int js_mapping_type_init() {
+    js_mapping_type.tp_name = "v8py.JSMapping";
+    js_mapping_type.tp_basicsize = sizeof(js_object);
+    js_mapping_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    js_mapping_type.tp_doc = "";
+    js_mapping_type.tp_base = &js_object_type;
+    js_mapping_type.tp_getattro = PyObject_GenericGetAttr;
+    js_mapping_type.tp_setattro = PyObject_GenericSetAttr;
+    js_mapping_type.tp_iter = (getiterfunc) js_mapping_getiter;
+    js_mapping_type.tp_richcompare = (richcmpfunc) js_view_richcompare;
+    js_mapping_type.tp_methods = js_mapping_methods;
+    js_mapping_type.tp_as_mapping = &js_mapping_mapping_methods;
+    js_mapping_type.tp_as_sequence = &js_mapping_sequence_methods;
+    return PyType_Ready(&js_mapping_type);
+}
+
+PyMappingMethods js_sequence_mapping_methods = {
+    (lenfunc) js_sequence_length, (binaryfunc) js_sequence_getitem, (objobjargproc) js_sequence_setitem
+};
+PySequenceMethods js_sequence_sequence_methods = {
+    (lenfunc) js_sequence_length, NULL, NULL, (ssizeargfunc) js_sequence_item
+};
+PyTypeObject js_sequence_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+int js_sequence_type_init() {
+    js_sequence_type.tp_name = "v8py.JSSequence";
+    js_sequence_type.tp_basicsize = sizeof(js_object);
+    js_sequence_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    js_sequence_type.tp_doc = "";
+    js_sequence_type.tp_base = &js_object_type;
+    js_sequence_type.tp_getattro = PyObject_GenericGetAttr;
+    js_sequence_type.tp_setattro = PyObject_GenericSetAttr;
+    js_sequence_type.tp_iter = (getiterfunc) js_sequence_getiter;
+    js_sequence_type.tp_richcompare = (richcmpfunc) js_view_richcompare;
+    js_sequence_type.tp_as_mapping = &js_sequence_mapping_methods;
+    js_sequence_type.tp_as_sequence = &js_sequence_sequence_methods;
+    return PyType_Ready(&js_sequence_type);
+}
+
+static js_object *js_view_new(PyTypeObject *type, Local<Object> object, Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
+    js_object *self = (js_object *) type->tp_alloc(type, 0);
+    if (self != NULL) {
+        self->object.Reset(isolate, object);
+        self->py_isolate = isolate_get_object(isolate);
+        Py_INCREF(self->py_isolate);
+    }
+    return self;
+}
+
+js_object *js_mapping_new(Local<Object> object, Local<Context> context) {
+    return js_view_new(&js_mapping_type, object, context);
+}
+
+js_object *js_sequence_new(Local<Array> array, Local<Context> context) {
+    return js_view_new(&js_sequence_type, array, context);
+}
+
+// A view is equal to whatever a deep conversion would be equal to
+PyObject *js_view_richcompare(js_object *self, PyObject *other, int op) {
+    if (op != Py_EQ && op != Py_NE) {
+        Py_INCREF(Py_NotImplemented);
+        return Py_NotImplemented;
+    }
+    PyObject *copy;
+    {
+        IN_V8(self->py_isolate->isolate);
+        Local<Object> object = self->object.Get(isolate);
+        IN_CONTEXT(object->CreationContext());
+        JS_TRY
+        CONTEXT_DEADLINE(context);
+        copy = py_from_js(object, context, CONVERT_DEEP);
+        PY_PROPAGATE_JS;
+    }
+    PyErr_PROPAGATE(copy);
+    PyObject *result = PyObject_RichCompare(copy, other, op);
+    Py_DECREF(copy);
+    return result;
+}
+
+// Keys that aren't strings or symbols (numbers, mostly) get turned into
+// strings first, like JavaScript would
+static Maybe<bool> js_has_own(Local<Object> object, Local<Value> key, Local<Context> context) {
+    if (!key->IsName()) {
+        MaybeLocal<String> string_key = key->ToString(context);
+        if (string_key.IsEmpty()) {
+            return Nothing<bool>();
+        }
+        key = string_key.ToLocalChecked();
+    }
+    return object->HasOwnProperty(context, key.As<Name>());
+}
+
+Py_ssize_t js_mapping_length(js_object *self) {
+    IN_V8(self->py_isolate->isolate);
+    Local<Object> object = self->object.Get(isolate);
+    IN_CONTEXT(object->CreationContext());
+    JS_TRY
+
+    MaybeLocal<Array> keys = object->GetOwnPropertyNames(context);
+    PY_PROPAGATE_JS_RET(-1);
+    return keys.ToLocalChecked()->Length();
+}
+
+PyObject *js_mapping_getitem(js_object *self, PyObject *key) {
+    IN_V8(self->py_isolate->isolate);
+    Local<Object> object = self->object.Get(isolate);
+    IN_CONTEXT(object->CreationContext());
+    JS_TRY
+
+    CONTEXT_DEADLINE(context);
+    Local<Value> js_key = self->py_isolate->names->js_name(key, context);
+    Maybe<bool> has_key = js_has_own(object, js_key, context);
+    PY_PROPAGATE_JS;
+    if (!has_key.FromJust()) {
+        PyErr_SetObject(PyExc_KeyError, key);
+        return NULL;
+    }
+    MaybeLocal<Value> value = object->Get(context, js_key);
+    PY_PROPAGATE_JS;
+    return py_from_js(value.ToLocalChecked(), context, CONVERT_PROXY);
+}
+
+int js_mapping_setitem(js_object *self, PyObject *key, PyObject *value) {
+    IN_V8(self->py_isolate->isolate);
+    Local<Object> object = self->object.Get(isolate);
+    IN_CONTEXT(object->CreationContext());
+    JS_TRY
+
+    CONTEXT_DEADLINE(context);
+    Local<Value> js_key = self->py_isolate->names->js_name(key, context);
+    if (value != NULL) {
+        if (object->Set(context, js_key, js_from_py(value, context)).IsNothing()) {
+            PY_PROPAGATE_JS_;
+        }
+        return 0;
+    }
+    Maybe<bool> has_key = js_has_own(object, js_key, context);
+    PY_PROPAGATE_JS_;
+    if (!has_key.FromJust()) {
+        PyErr_SetObject(PyExc_KeyError, key);
+        return -1;
+    }
+    if (object->Delete(context, js_key).IsNothing()) {
+        PY_PROPAGATE_JS_;
+    }
+    return 0;
+}
+
+int js_mapping_contains(js_object *self, PyObject *key) {
+    IN_V8(self->py_isolate->isolate);
+    Local<Object> object = self->object.Get(isolate);
+    IN_CONTEXT(object->CreationContext());
+    JS_TRY
+
+    Local<Value> js_key = self->py_isolate->names->js_name(key, context);
+    Maybe<bool> has_key = js_has_own(object, js_key, context);
+    PY_PROPAGATE_JS_;
+    return has_key.FromJust();
+}
+
+#define MAPPING_KEYS 0
+#define MAPPING_VALUES 1
+#define MAPPING_ITEMS 2
+
+static PyObject *js_mapping_list(js_object *self, int what) {
+    IN_V8(self->py_isolate->isolate);
+    Local<Object> object = self->object.Get(isolate);
+    IN_CONTEXT(object->CreationContext());
+    JS_TRY
+
+    CONTEXT_DEADLINE(context);
+    MaybeLocal<Array> maybe_keys = object->GetOwnPropertyNames(context);
+    PY_PROPAGATE_JS;
+    Local<Array> js_keys = maybe_keys.ToLocalChecked();
+    NameCache *names = self->py_isolate->names;
+    uint32_t length = js_keys->Length();
+    PyObject *list = PyList_New(length);
+    PyErr_PROPAGATE(list);
+    for (uint32_t i = 0; i < length; i++) {
+        HandleScope item_hs(isolate);
+        Local<Value> js_key = js_keys->Get(context, i).ToLocalChecked();
+        PyObject *key = NULL;
+        PyObject *value = NULL;
+        if (what != MAPPING_VALUES) {
+            key = names->py_name(js_key, context);
+        }
+        if (what != MAPPING_KEYS && (key != NULL || what == MAPPING_VALUES)) {
+            MaybeLocal<Value> js_value = object->Get(context, js_key);
+            if (tc.HasCaught()) {
+                Py_XDECREF(key);
+                Py_DECREF(list);
+            }
+            PY_PROPAGATE_JS;
+            value = py_from_js(js_value.ToLocalChecked(), context, CONVERT_PROXY);
+        }
+
+        PyObject *item;
+        if (what == MAPPING_KEYS) {
+            item = key;
+        } else if (what == MAPPING_VALUES) {
+            item = value;
+        } else {
+            item = key != NULL && value != NULL ? PyTuple_Pack(2, key, value) : NULL;
+            Py_XDECREF(key);
+            Py_XDECREF(value);
+        }
+        if (item == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+PyObject *js_mapping_keys(js_object *self) {
+    return js_mapping_list(self, MAPPING_KEYS);
+}
+
+PyObject *js_mapping_values(js_object *self) {
+    return js_mapping_list(self, MAPPING_VALUES);
+}
+
+PyObject *js_mapping_items(js_object *self) {
+    return js_mapping_list(self, MAPPING_ITEMS);
+}
+
+PyObject *js_mapping_getiter(js_object *self) {
+    PyObject *keys = js_mapping_keys(self);
+    PyErr_PROPAGATE(keys);
+    PyObject *iter = PyObject_GetIter(keys);
+    Py_DECREF(keys);
+    return iter;
+}
+
+PyObject *js_mapping_get(js_object *self, PyObject *args) {
+    PyObject *key;
+    PyObject *default_value = Py_None;
+    if (!PyArg_ParseTuple(args, "O|O:get", &key, &default_value)) {
+        return NULL;
+    }
+    PyObject *value = js_mapping_getitem(self, key);
+    if (value == NULL && PyErr_ExceptionMatches(PyExc_KeyError)) {
+        PyErr_Clear();
+        Py_INCREF(default_value);
+        return default_value;
+    }
+    return value;
+}
+
+Py_ssize_t js_sequence_length(js_object *self) {
+    IN_V8(self->py_isolate->isolate);
+    return self->object.Get(isolate).As<Array>()->Length();
+}
+
+PyObject *js_sequence_item(js_object *self, Py_ssize_t index) {
+    IN_V8(self->py_isolate->isolate);
+    Local<Array> array = self->object.Get(isolate).As<Array>();
+    IN_CONTEXT(array->CreationContext());
+    JS_TRY
+
+    if (index < 0 || index >= array->Length()) {
+        PyErr_SetString(PyExc_IndexError, "index out of range");
+        return NULL;
+    }
+    CONTEXT_DEADLINE(context);
+    MaybeLocal<Value> value = array->Get(context, (uint32_t) index);
+    PY_PROPAGATE_JS;
+    return py_from_js(value.ToLocalChecked(), context, CONVERT_PROXY);
+}
+
+// Slicing gives a list of what's in the slice, converted as views
+static PyObject *js_sequence_slice(js_object *self, PyObject *slice) {
+    IN_V8(self->py_isolate->isolate);
+    Local<Array> array = self->object.Get(isolate).As<Array>();
+    IN_CONTEXT(array->CreationContext());
+    JS_TRY
+
+    Py_ssize_t start, stop, step, count;
+#if PY_MAJOR_VERSION >= 3
+    if (PySlice_GetIndicesEx(slice, array->Length(), &start, &stop, &step, &count) < 0) {
+#else
+    if (PySlice_GetIndicesEx((PySliceObject *) slice, array->Length(), &start, &stop, &step, &count) < 0) {
+#endif
+        return NULL;
+    }
+    PyObject *list = PyList_New(count);
+    PyErr_PROPAGATE(list);
+    CONTEXT_DEADLINE(context);
+    for (Py_ssize_t i = 0, index = start; i < count; i++, index += step) {
+        HandleScope item_hs(isolate);
+        MaybeLocal<Value> value = array->Get(context, (uint32_t) index);
+        if (tc.HasCaught()) {
+            Py_DECREF(list);
+        }
+        PY_PROPAGATE_JS;
+        PyObject *item = py_from_js(value.ToLocalChecked(), context, CONVERT_PROXY);
+        if (item == NULL) {
+            Py_DECREF(list);
+            return NULL;
+        }
+        PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+PyObject *js_sequence_getitem(js_object *self, PyObject *key) {
+    if (PySlice_Check(key)) {
+        return js_sequence_slice(self, key);
+    }
+    Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (index == -1 && PyErr_Occurred()) {
+        return NULL;
+    }
+    if (index < 0) {
+        index += js_sequence_length(self);
+    }
+    return js_sequence_item(self, index);
+}
+
+int js_sequence_setitem(js_object *self, PyObject *key, PyObject *value) {
+    if (value == NULL || PySlice_Check(key)) {
+        PyErr_SetString(PyExc_TypeError, "can only assign single items to a JavaScript array");
+        return -1;
+    }
+    Py_ssize_t index = PyNumber_AsSsize_t(key, PyExc_IndexError);
+    if (index == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+
+    IN_V8(self->py_isolate->isolate);
+    Local<Array> array = self->object.Get(isolate).As<Array>();
+    IN_CONTEXT(array->CreationContext());
+    JS_TRY
+
+    if (index < 0) {
+        index += array->Length();
+    }
+    if (index < 0 || index >= array->Length()) {
+        PyErr_SetString(PyExc_IndexError, "index out of range");
+        return -1;
+    }
+    CONTEXT_DEADLINE(context);
+    if (array->Set(context, (uint32_t) index, js_from_py(value, context)).IsNothing()) {
+        PY_PROPAGATE_JS_;
+    }
+    return 0;
+}
+
+PyObject *js_sequence_getiter(js_object *self) {
+    return PySeqIter_New((PyObject *) self);
+}
@@ -28,15 +28,14 @@ using/*Kappa*/namespace/*Kappa*/v8;
 /*Kappa*/V(IZ_DAT_OBJECT, "A wild object appeared! Kappa") \
     // really need more of these Kappa Kappa
 
-#define DECLARE_MAGIC(name, string) extern Persistent<String> name##p;
-MAGIC_CONSTANT_STRING_LIST_KAPPA(DECLARE_MAGIC)
-#undef DECLARE_MAGIC // Kappa
+// Every isolate gets its own memes, they live in isolate_c Kappa
 // You can't go so far as to define a macro in a macro so Kappa
-#define I_CAN_HAZ_ERROR_PROTOTYPE I_CAN_HAZ_ERROR_PROTOTYPEp.Get(isolate)
-#define IZ_DAT_OBJECT IZ_DAT_OBJECTp.Get(isolate)
+#define I_CAN_HAZ_ERROR_PROTOTYPE isolate_get_object(isolate)->I_CAN_HAZ_ERROR_PROTOTYPEp.Get(isolate)
+#define IZ_DAT_OBJECT isolate_get_object(isolate)->IZ_DAT_OBJECTp.Get(isolate)
 
 // boring function prototype Kappa
-void create_memes_plz_thx();
+struct isolate_c_;
+void create_memes_plz_thx(struct isolate_c_ *self);
 // Kappa 
 
 // They do nothing for us Kappa
@@ -0,0 +1,151 @@
+#include <Python.h>
+#include "v8py.h"
+#include <v8.h>
+
+#include "convert.h"
+#include "pyclass.h"
+#include "context.h"
+#include "isolate.h"
+#include "live.h"
+
+using namespace v8;
+
+PyTypeObject live_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+int live_type_init() {
+    live_type.tp_name = "v8py.live";
+    live_type.tp_basicsize = sizeof(live_c);
+    live_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    live_type.tp_doc = "Wraps a dict or list so it's passed to JavaScript by reference instead of copied";
+    live_type.tp_new = (newfunc) live_new;
+    live_type.tp_dealloc = (destructor) live_dealloc;
+    return PyType_Ready(&live_type);
+}
+
+PyObject *live_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    PyObject *object;
+    static const char *keywords[] = {"object", NULL};
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "O", (char **) keywords, &object) < 0) {
+        return NULL;
+    }
+    if (!PyDict_Check(object) && !PyList_Check(object)) {
+        PyErr_SetString(PyExc_TypeError, "live needs a dict or a list");
+        return NULL;
+    }
+    live_c *self = (live_c *) type->tp_alloc(type, 0);
+    PyErr_PROPAGATE(self);
+    Py_INCREF(object);
+    self->object = object;
+    return (PyObject *) self;
+}
+
+void live_dealloc(live_c *self) {
+    Py_DECREF(self->object);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+// One template each for dicts and lists per isolate. The handler data is
+// what tells the interceptors in pyclasshandlers.cpp they're serving a live
+// object and not an instance of an exposed class.
+static Local<ObjectTemplate> live_template(Isolate *isolate, bool list) {
+    EscapableHandleScope hs(isolate);
+    isolate_c *py_isolate = isolate_get_object(isolate);
+    Persistent<ObjectTemplate> &cached = list ? py_isolate->live_list_template : py_isolate->live_dict_template;
+    if (!cached.IsEmpty()) {
+        return hs.Escape(cached.Get(isolate));
+    }
+
+    Local<ObjectTemplate> templ = ObjectTemplate::New(isolate);
+    templ->SetInternalFieldCount(OBJECT_INTERNAL_FIELDS);
+    Local<Value> live = True(isolate);
+    if (list) {
+        templ->SetHandler(IndexedPropertyHandlerConfiguration(
+                    indexed_getter, indexed_setter, indexed_query, NULL, indexed_enumerator, live));
+        templ->SetAccessor(JSTR("length"), live_length_getter, live_length_setter, Local<Value>(), DEFAULT,
+                static_cast<PropertyAttribute>(DontEnum | DontDelete));
+    } else {
+        templ->SetHandler(NamedPropertyHandlerConfiguration(
+                    named_getter, named_setter, named_query, named_deleter, named_enumerator, live));
+    }
+    cached.Reset(isolate, templ);
+    return hs.Escape(templ);
+}
+
+// The wrapper is cached for as long as it lives, so the same dict or list is
+// the same object in JavaScript, and reading it again doesn't allocate
+Local<Object> js_live_from_py(PyObject *value, Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
+    EscapableHandleScope hs(isolate);
+    Local<Object> object = context_get_cached_jsobject(context, value);
+    if (!object.IsEmpty()) {
+        return hs.Escape(object);
+    }
+
+    bool list = PyList_Check(value);
+    object = live_template(isolate, list)->NewInstance(context).ToLocalChecked();
+    if (list) {
+        object->SetPrototype(context, context->GetEmbedderData(ARRAY_PROTOTYPE_SLOT)).FromJust();
+    }
+    Py_INCREF(value);
+    py_class_wrap_js_object(object, value, context);
+    context_set_cached_jsobject(context, value, object);
+    return hs.Escape(object);
+}
+
+Local<Value> js_live_item_from_py(PyObject *value, Local<Context> context) {
+    if (PyDict_Check(value) || PyList_Check(value)) {
+        return js_live_from_py(value, context);
+    }
+    return js_from_py(value, context);
+}
+
+template <class T> static PyObject *live_get_list(const PropertyCallbackInfo<T> &info) {
+    return (PyObject *) info.Holder()->GetInternalField(1).template As<External>()->Value();
+}
+
+void live_length_getter(Local<String> name, const PropertyCallbackInfo<Value> &info) {
+    WITH_GIL;
+    info.GetReturnValue().Set((double) PyList_GET_SIZE(live_get_list(info)));
+}
+
+// Setting length truncates the list, or pads it with None (which is
+// undefined in JavaScript), so pop and push work. Growing is capped, since
+// filling in a huge length happens with the GIL held and a timeout can't
+// stop it.
+#define LIVE_LIST_MAX_GROWTH 65536
+
+void live_length_setter(Local<String> name, Local<Value> value, const PropertyCallbackInfo<void> &info) {
+    WITH_GIL;
+    Isolate *isolate = info.GetIsolate();
+    HandleScope hs(isolate);
+    Local<Context> context = isolate->GetCurrentContext();
+    PyObject *list = live_get_list(info);
+
+    Maybe<uint32_t> maybe_length = value->Uint32Value(context);
+    if (maybe_length.IsNothing()) {
+        return;
+    }
+    Py_ssize_t length = maybe_length.FromJust();
+    Py_ssize_t old_length = PyList_GET_SIZE(list);
+    if (length < old_length) {
+        JS_PROPAGATE_PY_(PyList_SetSlice(list, length, old_length, NULL));
+    } else if (length > old_length) {
+        if (length - old_length > LIVE_LIST_MAX_GROWTH) {
+            isolate->ThrowException(Exception::RangeError(JSTR("Can't grow a live list by that much at once")));
+            return;
+        }
+        PyObject *padding = PyList_New(length - old_length);
+        if (padding == NULL) {
+            js_throw_py();
+            return;
+        }
+        for (Py_ssize_t i = 0; i < length - old_length; i++) {
+            Py_INCREF(Py_None);
+            PyList_SET_ITEM(padding, i, Py_None);
+        }
+        int result = PyList_SetSlice(list, old_length, old_length, padding);
+        Py_DECREF(padding);
+        JS_PROPAGATE_PY_(result);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <Python.h>
+#include <v8.h>
+
+using namespace v8;
+
+// live(obj) passes a dict or list to JavaScript by reference instead of
+// copying it. JavaScript gets an object whose properties (or indexes, and
+// length) are read from and written to the Python object by interceptors, so
+// passing it is O(1), items are only converted when they're touched, and
+// changes are seen on both sides. Dicts and lists inside it are live too.
+// A live list has Array.prototype as its prototype, so the array methods
+// work on it, though Array.isArray is false.
+typedef struct {
+    PyObject_HEAD
+    PyObject *object;
+} live_c;
+extern PyTypeObject live_type;
+int live_type_init();
+
+PyObject *live_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void live_dealloc(live_c *self);
+
+// value is a dict or list
+Local<Object> js_live_from_py(PyObject *value, Local<Context> context);
+// What the interceptors return for an item, which is live if it's a dict or
+// list and converted like usual otherwise
+Local<Value> js_live_item_from_py(PyObject *value, Local<Context> context);
+
+void live_length_getter(Local<String> name, const PropertyCallbackInfo<Value> &info);
+void live_length_setter(Local<String> name, Local<Value> value, const PropertyCallbackInfo<void> &info);
+
+#endif
@@ -0,0 +1,107 @@
+#include <Python.h>
+#include "v8py.h"
+#include <v8.h>
+
+#include "convert.h"
+#include "names.h"
+
+using namespace v8;
+
+#define TABLE_SIZE(table) (sizeof(table) / sizeof(table[0]))
+
+NameCache::~NameCache() {
+    for (size_t i = 0; i < TABLE_SIZE(from_js_); i++) {
+        from_js_[i].js.Reset();
+        Py_CLEAR(from_js_[i].py);
+    }
+    for (size_t i = 0; i < TABLE_SIZE(to_js_); i++) {
+        to_js_[i].js.Reset();
+        Py_CLEAR(to_js_[i].py);
+    }
+}
+
+PyObject *NameCache::py_name(Local<Value> value, Local<Context> context) {
+    if (!value->IsString() || value.As<String>()->Length() > NAME_CACHE_MAX_LENGTH) {
+        return py_from_js(value, context);
+    }
+    Local<String> name = value.As<String>();
+    // internalized strings are the same object wherever the name shows up,
+    // and property names almost always are
+    entry &slot = from_js_[name->GetIdentityHash() & (TABLE_SIZE(from_js_) - 1)];
+    if (slot.py != NULL && slot.js == name) {
+        Py_INCREF(slot.py);
+        return slot.py;
+    }
+
+    PyObject *py_name = py_from_js_string(name);
+    PyErr_PROPAGATE(py_name);
+#if PY_MAJOR_VERSION >= 3
+    PyUnicode_InternInPlace(&py_name);
+#endif
+    slot.js.Reset(isolate_, name);
+    Py_XDECREF(slot.py);
+    Py_INCREF(py_name);
+    slot.py = py_name;
+    return py_name;
+}
+
+// Only plain strs are cached, subclasses could compare equal to anything
+static bool name_cacheable(PyObject *name) {
+#if PY_MAJOR_VERSION >= 3
+    return PyUnicode_CheckExact(name) && PyUnicode_READY(name) == 0 &&
+        PyUnicode_GET_LENGTH(name) <= NAME_CACHE_MAX_LENGTH;
+#else
+    return PyString_CheckExact(name) && PyString_GET_SIZE(name) <= NAME_CACHE_MAX_LENGTH;
+#endif
+}
+
+static bool same_name(PyObject *a, PyObject *b) {
+    if (a == b) {
+        return true;
+    }
+#if PY_MAJOR_VERSION >= 3
+    return PyUnicode_GET_LENGTH(a) == PyUnicode_GET_LENGTH(b) && PyUnicode_Compare(a, b) == 0;
+#else
+    return PyString_GET_SIZE(a) == PyString_GET_SIZE(b) &&
+        memcmp(PyString_AS_STRING(a), PyString_AS_STRING(b), PyString_GET_SIZE(a)) == 0;
+#endif
+}
+
+Local<Value> NameCache::js_name(PyObject *name, Local<Context> context) {
+    if (!name_cacheable(name)) {
+        return js_from_py(name, context);
+    }
+    // strs cache their hash, and names used as attributes are interned, so
+    // this is usually a pointer compare
+    Py_hash_t hash = PyObject_Hash(name);
+    entry &slot = to_js_[(size_t) hash & (TABLE_SIZE(to_js_) - 1)];
+    if (slot.py != NULL && PyObject_Hash(slot.py) == hash && same_name(slot.py, name)) {
+        return slot.js.Get(isolate_);
+    }
+
+    Local<String> js_name = js_internalized_from_py(isolate_, name);
+    if (js_name.IsEmpty()) {
+        return js_from_py(name, context);
+    }
+    slot.js.Reset(isolate_, js_name);
+    Py_XDECREF(slot.py);
+    Py_INCREF(name);
+    slot.py = name;
+    return js_name;
+}
+
+Local<String> js_internalized_from_py(Isolate *isolate, PyObject *name) {
+    Py_ssize_t length;
+#if PY_MAJOR_VERSION >= 3
+    const char *utf8 = PyUnicode_AsUTF8AndSize(name, &length);
+#else
+    const char *utf8 = PyString_AS_STRING(name);
+    length = PyString_GET_SIZE(name);
+#endif
+    if (utf8 == NULL) {
+        PyErr_Clear();
+        return Local<String>();
+    }
+    MaybeLocal<String> js_name = String::NewFromUtf8(isolate, utf8, NewStringType::kInternalized, length);
+    return js_name.FromMaybe(Local<String>());
+}
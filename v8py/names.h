@@ -0,0 +1,50 @@
+#ifndef NAMES_H
+#define NAMES_H
+
+#include <Python.h>
+#include <v8.h>
+
+using namespace v8;
+
+// The same few property names cross between Python and V8 over and over, so
+// each isolate remembers the last conversion of each name, both ways. Each
+// direction is a fixed size table indexed by hash, where a new name just
+// replaces whatever was in its slot, so it can't grow and steady state
+// conversions allocate nothing.
+// Python names are interned.
+//
+// Only use it with the isolate locked and the GIL held.
+class NameCache {
+    public:
+        NameCache(Isolate *isolate) : isolate_(isolate) {}
+        ~NameCache();
+
+        // New reference to a str for the name, or NULL with an exception.
+        // Anything but a short string is just converted.
+        PyObject *py_name(Local<Value> name, Local<Context> context);
+        // An internalized string for a str. Anything but a short str is just
+        // converted.
+        Local<Value> js_name(PyObject *name, Local<Context> context);
+
+    private:
+        NameCache(const NameCache &);
+        NameCache &operator=(const NameCache &);
+
+        struct entry {
+            Global<String> js;
+            PyObject *py;
+            entry() : py(NULL) {}
+        };
+        Isolate *isolate_;
+        entry from_js_[1024];
+        entry to_js_[1024];
+};
+
+// An internalized V8 string with the contents of a str, or empty with the
+// Python exception cleared if there isn't one
+Local<String> js_internalized_from_py(Isolate *isolate, PyObject *name);
+
+// names longer than this aren't worth keeping
+#define NAME_CACHE_MAX_LENGTH 64
+
+#endif
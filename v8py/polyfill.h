@@ -31,6 +31,10 @@ inline extern int PyString_StartsWithString(PyObject *str, const char *prefix) {
     return retval;
 }
 
+#if PY_MAJOR_VERSION < 3
+typedef long Py_hash_t;
+#endif
+
 #endif
 
 #if PY_MAJOR_VERSION >= 3
@@ -47,5 +51,6 @@ inline extern int PyString_StartsWithString(PyObject *str, const char *prefix) {
 #define nb_nonzero nb_bool
 
 #define Py_TPFLAGS_HAVE_WEAKREFS 0
+#define Py_TPFLAGS_HAVE_NEWBUFFER 0
 
 #endif
@@ -20,13 +20,9 @@ int py_class_type_init() {
     return PyType_Ready(&py_class_type);
 }
 
-static PyObject *template_dict = NULL;
-
+// Templates belong to an isolate, so each isolate has its own dict of them
 PyObject *py_class_to_template(PyObject *cls) {
-    if (template_dict == NULL) {
-        template_dict = PyDict_New();
-        PyErr_PROPAGATE(template_dict);
-    }
+    PyObject *template_dict = isolate_get_object(Isolate::GetCurrent())->class_templates;
 
     PyObject *templ = PyDict_GetItem(template_dict, cls);
     if (templ != NULL) {
@@ -46,7 +42,7 @@ PyObject *py_class_to_template(PyObject *cls) {
 int add_class_to_template(PyObject *cls, Local<FunctionTemplate> templ);
 
 PyObject *py_class_new(PyObject *cls) {
-    IN_V8;
+    IN_V8(Isolate::GetCurrent());
 
     // The convert functions require a context for function conversion, but we
     // don't have a context. So we use an empty context and special-case
@@ -195,6 +191,7 @@ bool if_property_has(PyObject *property, const char *what) {
 
 // 0 on success, -1 on failure
 int add_to_template(PyObject *cls, PyObject *member_name, PyObject *member_value, Local<FunctionTemplate> templ) {
+    CURRENT_ISOLATE;
     HandleScope hs(isolate);
     Local<Context> no_ctx;
     Local<Signature> sig = Signature::New(isolate, templ);
@@ -253,6 +250,7 @@ int add_to_template(PyObject *cls, PyObject *member_name, PyObject *member_value
 }
 
 Local<Function> py_class_get_constructor(py_class *self, Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
     EscapableHandleScope hs(isolate);
     Local<Function> function = self->templ->Get(isolate)->GetFunction(context).ToLocalChecked();
     function->SetName(js_from_py(self->cls_name, context).As<String>());
@@ -260,6 +258,8 @@ Local<Function> py_class_get_constructor(py_class *self, Local<Context> context)
 }
 
 void py_class_object_weak_callback(const WeakCallbackInfo<Persistent<Object>> &info) {
+    WITH_GIL;
+    Isolate *isolate = info.GetIsolate();
     HandleScope hs(isolate);
     Local<Object> js_object = info.GetParameter()->Get(isolate);
     assert(js_object->GetInternalField(0) == IZ_DAT_OBJECT);
@@ -272,10 +272,19 @@ void py_class_object_weak_callback(const WeakCallbackInfo<Persistent<Object>> &i
     delete info.GetParameter();
 }
 
-void py_class_init_js_object(Local<Object> js_object, PyObject *py_object, Local<Context> context) {
+void py_class_wrap_js_object(Local<Object> js_object, PyObject *py_object, Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
     js_object->SetInternalField(0, IZ_DAT_OBJECT);
     js_object->SetInternalField(1, External::New(isolate, py_object));
 
+    Persistent<Object> *obj_handle = new Persistent<Object>(isolate, js_object);
+    obj_handle->SetWeak(obj_handle, py_class_object_weak_callback, WeakCallbackType::kFinalizer);
+}
+
+void py_class_init_js_object(Local<Object> js_object, PyObject *py_object, Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
+    py_class_wrap_js_object(js_object, py_object, context);
+
     // find out if the object is supposed to inherit from Error
     // the information is in an internal field on the last prototype
     Local<Value> last_proto = js_object;
@@ -292,13 +301,11 @@ void py_class_init_js_object(Local<Object> js_object, PyObject *py_object, Local
         last_proto_object->SetPrototype(context->GetEmbedderData(ERROR_PROTOTYPE_SLOT));
     }
 
-    Persistent<Object> *obj_handle = new Persistent<Object>(isolate, js_object);
-    obj_handle->SetWeak(obj_handle, py_class_object_weak_callback, WeakCallbackType::kFinalizer);
-
     context_set_cached_jsobject(context, py_object, js_object);
 }
 
 Local<Object> py_class_create_js_object(py_class *self, PyObject *py_object, Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
     EscapableHandleScope hs(isolate);
 
     Local<Object> object = context_get_cached_jsobject(context, py_object);
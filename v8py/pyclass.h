@@ -20,6 +20,10 @@ PyObject *py_class_to_template(PyObject *cls);
 Local<Function> py_class_get_constructor(py_class *self, Local<Context> context);
 Local<Object> py_class_create_js_object(py_class *self, PyObject *py_object, Local<Context> context);
 void py_class_init_js_object(Local<Object> js_object, PyObject *py_object, Local<Context> context);
+// Points the internal fields of js_object at py_object, and keeps the
+// reference to py_object (which the caller gives it) until js_object is
+// collected
+void py_class_wrap_js_object(Local<Object> js_object, PyObject *py_object, Local<Context> context);
 
 // first one is magic pointer
 // second one is actual object
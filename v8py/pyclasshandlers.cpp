@@ -4,8 +4,13 @@
 #include "v8py.h"
 #include "convert.h"
 #include "pyclass.h"
+#include "isolate.h"
+#include "names.h"
+#include "live.h"
 
 void py_class_construct_callback(const FunctionCallbackInfo<Value> &info) {
+    WITH_GIL;
+    Isolate *isolate = info.GetIsolate();
     HandleScope hs(isolate);
     py_class *self = (py_class *) info.Data().As<External>()->Value();
     Local<Context> context = isolate->GetCurrentContext();
@@ -35,6 +40,8 @@ void py_class_construct_callback(const FunctionCallbackInfo<Value> &info) {
 }
 
 void py_class_method_callback(const FunctionCallbackInfo<Value> &info) {
+    WITH_GIL;
+    Isolate *isolate = info.GetIsolate();
     HandleScope hs(isolate);
     Local<Context> context = isolate->GetCurrentContext();
 
@@ -74,7 +81,7 @@ void py_class_method_callback(const FunctionCallbackInfo<Value> &info) {
 // --- Interceptors ---
 
 template <class T> inline extern PyObject *get_self(const PropertyCallbackInfo<T> &info) {
-    Local<Context> context = isolate->GetCurrentContext();
+    Local<Context> context = info.GetIsolate()->GetCurrentContext();
     Local<Object> js_self = info.Holder();
     if (js_self == context->Global()) {
         js_self = js_self->GetPrototype().As<Object>();
@@ -84,6 +91,13 @@ template <class T> inline extern PyObject *get_self(const PropertyCallbackInfo<T
 
 #define Info(T) const PropertyCallbackInfo<T> &info
 
+// Live dicts and lists (see live.cpp) use the same interceptors, with true
+// as the handler data. Their items aren't hidden by Python attributes, are
+// enumerable, and dicts and lists in them are passed live too.
+template <class T> inline extern bool is_live(const PropertyCallbackInfo<T> &info) {
+    return info.Data()->IsTrue();
+}
+
 // getter
 // __getitem__
 // setter
@@ -96,15 +110,18 @@ template <class T> inline extern PyObject *get_self(const PropertyCallbackInfo<T
 // 
 
 #define NAMED(code) { \
+    WITH_GIL; \
+    Isolate *isolate = info.GetIsolate(); \
     HandleScope hs(isolate); \
     Local<Context> context = isolate->GetCurrentContext(); \
-    PyObject *name = py_from_js(js_name, context); \
+    PyObject *name = isolate_get_object(isolate)->names->py_name(js_name, context); \
     JS_PROPAGATE_PY(name); \
     code; \
     Py_DECREF(name); \
 }
 
 #define INDEXED(code) { \
+    WITH_GIL; \
     PyObject *idx = PyLong_FromSize_t(index); \
     JS_PROPAGATE_PY(idx); \
     code; \
@@ -112,10 +129,11 @@ template <class T> inline extern PyObject *get_self(const PropertyCallbackInfo<T
 }
 
 #define SETUP \
+    Isolate *isolate = info.GetIsolate(); \
     HandleScope hs(isolate); \
     Local<Context> context = isolate->GetCurrentContext();
 #define CHECK_ATTR \
-    if (PyObject_HasAttr(get_self(info), key)) { \
+    if (!is_live(info) && PyObject_HasAttr(get_self(info), key)) { \
         return; \
     }
 
@@ -127,8 +145,17 @@ void getter_callback(PyObject *key, Info(Value)) {
     }
 
     PyObject *value = PyObject_GetItem(get_self(info), key);
+    if (value == NULL && is_live(info) && PyErr_ExceptionMatches(PyExc_KeyError)) {
+        // not a key, so look on the prototype
+        PyErr_Clear();
+        return;
+    }
     JS_PROPAGATE_PY(value);
-    info.GetReturnValue().Set(js_from_py(value, context));
+    if (is_live(info)) {
+        info.GetReturnValue().Set(js_live_item_from_py(value, context));
+    } else {
+        info.GetReturnValue().Set(js_from_py(value, context));
+    }
     Py_DECREF(value);
 }
 void named_getter(Local<Name> js_name, Info(Value)) NAMED(getter_callback(name, info))
@@ -138,7 +165,16 @@ void setter_callback(PyObject *key, Local<Value> js_value, Info(Value)) {
     SETUP; CHECK_ATTR;
     PyObject *value = py_from_js(js_value, context);
     JS_PROPAGATE_PY(value);
-    if (PyObject_SetItem(get_self(info), key, value) < 0) {
+    PyObject *self = get_self(info);
+    int result;
+    if (is_live(info) && PyList_Check(self) && PyIndex_Check(key) &&
+            PyNumber_AsSsize_t(key, NULL) == PyList_GET_SIZE(self)) {
+        // setting the item just past the end is how push works
+        result = PyList_Append(self, value);
+    } else {
+        result = PyObject_SetItem(self, key, value);
+    }
+    if (result < 0) {
         Py_DECREF(value);
         js_throw_py();
         return;
@@ -150,8 +186,16 @@ void named_setter(Local<Name> js_name, Local<Value> value, Info(Value)) NAMED(se
 void indexed_setter(uint32_t index, Local<Value> value, Info(Value)) INDEXED(setter_callback(idx, value, info))
 
 void deleter_callback(PyObject *key, Info(Boolean)) {
+    Isolate *isolate = info.GetIsolate();
     CHECK_ATTR;
     if (PyObject_DelItem(get_self(info), key) < 0) {
+        bool missing = PyErr_ExceptionMatches(PyExc_KeyError);
+        PyErr_Clear();
+        if (missing && is_live(info)) {
+            // deleting a property that isn't there works in JavaScript
+            info.GetReturnValue().Set(True(isolate));
+            return;
+        }
         if (info.ShouldThrowOnError()) {
             isolate->ThrowException(Exception::TypeError(JSTR("Unable to delete property.")));
             return;
@@ -173,6 +217,14 @@ void query_callback(PyObject *key, Info(Integer)) {
         if (PyNumber_AsSsize_t(key, NULL) >= PyObject_Size(self)) {
             return;
         }
+    } else if (is_live(info)) {
+        switch (PySequence_Contains(self, key)) {
+            case -1:
+                js_throw_py();
+                // intentional fall-through
+            case 0:
+                return;
+        }
     } else {
         // check for no such attribute
         PyObject *keys = PyObject_CallMethod(get_self(info), "keys", "");
@@ -186,6 +238,11 @@ void query_callback(PyObject *key, Info(Integer)) {
         }
     }
 
+    if (is_live(info)) {
+        // writable, enumerable and configurable, like a plain object's
+        info.GetReturnValue().Set(static_cast<int32_t>(None));
+        return;
+    }
     int descriptor = DontEnum;
     PyObject *cls = (PyObject *) Py_TYPE(self);
     if (!PyObject_HasAttrString(cls, "__setitem__")) {
@@ -200,26 +257,30 @@ void named_query(Local<Name> js_name, Info(Integer)) NAMED(query_callback(name,
 void indexed_query(uint32_t index, Info(Integer)) INDEXED(query_callback(idx, info))
 
 void named_enumerator(Info(Array)) {
+    WITH_GIL;
     SETUP;
-    PyObject *keys = PyObject_CallMethod(get_self(info), "keys", "");
+    PyObject *keys_view = PyObject_CallMethod(get_self(info), "keys", "");
+    JS_PROPAGATE_PY(keys_view);
+    // keys() is a view on Python 3, which can't be indexed
+    PyObject *keys = PySequence_Fast(keys_view, "keys() must return an iterable");
+    Py_DECREF(keys_view);
     JS_PROPAGATE_PY(keys);
-    Local<Array> js_keys = Array::New(isolate, PySequence_Length(keys));
-    for (int i = 0; i < PySequence_Length(keys); i++) {
-        PyObject *item = PySequence_ITEM(keys, i);
-        if (item == NULL) {
-            Py_DECREF(keys);
-            js_throw_py();
-            return;
-        }
-        js_keys->Set(context, i, js_from_py(item, context)).FromJust();
+    Local<Array> js_keys = Array::New(isolate, PySequence_Fast_GET_SIZE(keys));
+    NameCache *names = isolate_get_object(isolate)->names;
+    for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(keys); i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(keys, i);
+        js_keys->Set(context, i, names->js_name(item, context)).FromJust();
     }
+    Py_DECREF(keys);
     info.GetReturnValue().Set(js_keys);
 }
 void indexed_enumerator(Info(Array)) {
+    WITH_GIL;
     SETUP;
     Py_ssize_t length = PyObject_Size(get_self(info));
     if (length < 0) {
         js_throw_py();
+        return;
     }
     Local<Array> keys = Array::New(isolate, length);
     for (int i = 0; i < length; i++) {
@@ -229,25 +290,36 @@ void indexed_enumerator(Info(Array)) {
 }
 
 void py_class_property_getter(Local<Name> js_name, Info(Value)) {
+    WITH_GIL;
+    Isolate *isolate = info.GetIsolate();
     HandleScope hs(isolate);
     Local<Context> context = isolate->GetCurrentContext();
 
-    PyObject *name = py_from_js(js_name, context);
+    PyObject *name = isolate_get_object(isolate)->names->py_name(js_name, context);
     JS_PROPAGATE_PY(name);
     PyObject *value = PyObject_GetAttr(get_self(info), name);
+    Py_DECREF(name);
     JS_PROPAGATE_PY(value);
     info.GetReturnValue().Set(js_from_py(value, context));
+    Py_DECREF(value);
 }
 
 void py_class_property_setter(Local<Name> js_name, Local<Value> js_value, Info(void)) {
+    WITH_GIL;
+    Isolate *isolate = info.GetIsolate();
     HandleScope hs(isolate);
     Local<Context> context = isolate->GetCurrentContext();
 
-    PyObject *name = py_from_js(js_name, context);
+    PyObject *name = isolate_get_object(isolate)->names->py_name(js_name, context);
     JS_PROPAGATE_PY(name);
     PyObject *value = py_from_js(js_value, context);
+    if (value == NULL) {
+        Py_DECREF(name);
+    }
     JS_PROPAGATE_PY(value);
     int result = PyObject_SetAttr(get_self(info), name, value);
+    Py_DECREF(name);
+    Py_DECREF(value);
     JS_PROPAGATE_PY_(result);
 }
 
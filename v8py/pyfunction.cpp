@@ -19,10 +19,8 @@ int py_function_type_init() {
     return PyType_Ready(&py_function_type);
 }
 
-static void py_function_callback(const FunctionCallbackInfo<Value> &info);
-
 PyObject *py_function_new(PyObject *function) {
-    IN_V8;
+    IN_V8(Isolate::GetCurrent());
 
     py_function *self = (py_function *) py_function_type.tp_alloc(&py_function_type, 0);
     PyErr_PROPAGATE(self);
@@ -45,13 +43,8 @@ PyObject *py_function_new(PyObject *function) {
     return (PyObject *) self;
 }
 
-static PyObject *template_dict = NULL;
-
 PyObject *py_function_to_template(PyObject *func) {
-    if (template_dict == NULL) {
-        template_dict = PyDict_New();
-        PyErr_PROPAGATE(template_dict);
-    }
+    PyObject *template_dict = isolate_get_object(Isolate::GetCurrent())->function_templates;
 
     PyObject *templ = PyDict_GetItem(template_dict, func);
     if (templ != NULL) {
@@ -66,13 +59,16 @@ PyObject *py_function_to_template(PyObject *func) {
 }
 
 Local<Function> py_template_to_function(py_function *self, Local<Context> context) {
+    Isolate *isolate = context->GetIsolate();
     EscapableHandleScope hs(isolate);
     Local<Function> function = self->js_template->Get(isolate)->GetFunction(context).ToLocalChecked();
     function->SetName(js_from_py(self->function_name, context).As<String>());
     return hs.Escape(function);
 }
 
-static void py_function_callback(const FunctionCallbackInfo<Value> &info) {
+void py_function_callback(const FunctionCallbackInfo<Value> &info) {
+    WITH_GIL;
+    Isolate *isolate = info.GetIsolate();
     HandleScope hs(isolate);
     Local<Context> context = isolate->GetCurrentContext();
 
@@ -19,6 +19,7 @@ PyObject *py_function_new(PyObject *func);
 
 PyObject *py_function_to_template(PyObject *func);
 Local<Function> py_template_to_function(py_function *self, Local<Context> context);
+void py_function_callback(const FunctionCallbackInfo<Value> &info);
 
 extern PyTypeObject py_function_type;
 
@@ -2,7 +2,15 @@
 #include "v8py.h"
 #include <v8.h>
 
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
 #include "convert.h"
+#include "exception.h"
 #include "script.h"
 
 using namespace v8;
@@ -17,21 +25,66 @@ using namespace v8;
 // pointing to the object of ScriptLoader. ScriptLoader's get_source reads the
 // source out of scripts_by_name. When a script is created an entry is added to
 // scripts_by_name, when it is destroyed its entry is deleted from
-// scripts_by_name.
+// scripts_by_name. Script ids are only unique within an isolate, so scripts
+// compiled outside the default isolate also get the isolate index in their
+// name: {resource name}-{isolate index}.{script id}
+//
+// A compiled script can be serialized into a V8 code cache (Script.code_cache)
+// and passed back in as Script(source, code_cache=...) to skip parsing. With
+// set_code_cache_dir, caches are kept on disk automatically, in files named
+// after the SHA-1 of the source and V8's cache version tag, which changes
+// with the V8 version and flags. V8 checks a cache before using it anyway, so
+// a cache that's stale, truncated or for other source gets rejected, the
+// script is compiled from source and the file is written again.
+// Script(source, code_cache=True) makes a cache right away, which older V8
+// (before 6.5) can only do while compiling. code_cache=False stays away from
+// caches entirely; Context.eval compiles that way, so dynamic eval strings
+// don't each end up with a cache file.
+//
+// V8 normally compiles a function the first time it's called. Script(source,
+// eager=True) compiles all of them up front, which together with a code cache
+// means nothing is left to compile when the script first runs. That needs
+// kEagerCompile from V8 6.6; older V8 warns and compiles lazily. See the
+// Script docstring for opting in single functions.
 
 int script_loader_type_init();
-Eternal<Context> compile_context;
 PyObject *scripts_by_name;
 PyObject *script_loader;
 PyObject *javascript;
+static PyObject *code_cache_dir = NULL;
+static PyObject *io_module;
+static PyObject *os_module;
+static PyObject *os_path_module;
+static PyObject *sha1_function;
+
+// What Script.compile_many returns for each source
+static PyStructSequence_Field compile_result_fields[] = {
+    {(char *) "script", (char *) "the Script, or None if it didn't compile"},
+    {(char *) "error", (char *) "the exception if it didn't compile, otherwise None"},
+    {(char *) "compile_time", (char *) "seconds spent compiling"},
+    {NULL},
+};
+static PyStructSequence_Desc compile_result_desc = {
+    (char *) "v8py.CompileResult", NULL, compile_result_fields, 3,
+};
+static PyTypeObject compile_result_type;
+
+PyMethodDef script_methods[] = {
+    {"compile_async", (PyCFunction) script_compile_async, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
+    {"compile_many", (PyCFunction) script_compile_many, METH_VARARGS | METH_KEYWORDS | METH_CLASS, NULL},
+    {NULL},
+};
+PyGetSetDef script_getset[] = {
+    {(char *) "code_cache", (getter) script_get_code_cache, NULL, NULL, NULL},
+    {(char *) "code_cache_rejected", (getter) script_get_code_cache_rejected, NULL, NULL, NULL},
+    {(char *) "eager", (getter) script_get_eager, NULL, NULL, NULL},
+    {NULL},
+};
 
 PyTypeObject script_type = {
     PyVarObject_HEAD_INIT(NULL, 0)
 };
 int script_type_init() {
-    IN_V8;
-    compile_context.Set(isolate, Context::New(isolate));
-
     PyObject *weakref_module = PyImport_ImportModule("weakref");
     PyErr_PROPAGATE_(weakref_module);
     PyObject *weak_value_dict = PyObject_GetAttrString(weakref_module, "WeakValueDictionary");
@@ -41,44 +94,79 @@ int script_type_init() {
 
     javascript = PyString_InternFromString("javascript");
 
+    io_module = PyImport_ImportModule("io");
+    PyErr_PROPAGATE_(io_module);
+    os_module = PyImport_ImportModule("os");
+    PyErr_PROPAGATE_(os_module);
+    os_path_module = PyImport_ImportModule("os.path");
+    PyErr_PROPAGATE_(os_path_module);
+    PyObject *hashlib_module = PyImport_ImportModule("hashlib");
+    PyErr_PROPAGATE_(hashlib_module);
+    sha1_function = PyObject_GetAttrString(hashlib_module, "sha1");
+    Py_DECREF(hashlib_module);
+    PyErr_PROPAGATE_(sha1_function);
+
     script_type.tp_name = "v8py.Script";
     script_type.tp_basicsize = sizeof(script_c);
     script_type.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_WEAKREFS;
     script_type.tp_weaklistoffset = offsetof(script_c, weakrefs);
-    script_type.tp_doc = "";
+    script_type.tp_doc =
+        "Script(source, filename=None, isolate=None, code_cache=None, eager=False)\n\n"
+        "Compiled JavaScript that can be run in any context of its isolate.\n\n"
+        "code_cache is bytes from another Script's code_cache to skip parsing, True to\n"
+        "make a cache now, False to leave caches and the cache dir alone, or None to use\n"
+        "the cache dir if one is set.\n\n"
+        "eager=True compiles every function now instead of on its first call. It needs\n"
+        "V8 6.6 or newer; older V8 warns and compiles lazily, and eager is False. A source\n"
+        "already compiled in the isolate is reused as it was compiled. To have a single\n"
+        "function compiled eagerly, on any V8, wrap it in parentheses:\n\n"
+        "    var handler = (function (event) { ... });\n\n"
+        "V8 takes a parenthesized function as a hint it's called right away and compiles\n"
+        "it with the script.";
     script_type.tp_new = (newfunc) script_new;
     script_type.tp_dealloc = (destructor) script_dealloc;
+    script_type.tp_methods = script_methods;
+    script_type.tp_getset = script_getset;
     if (PyType_Ready(&script_type) < 0) return -1;
 
+    PyStructSequence_InitType(&compile_result_type, &compile_result_desc);
+
     return script_loader_type_init();
 }
 
-PyObject *construct_script_name(Local<Value> js_name, int id) {
+PyObject *construct_script_name(Isolate *isolate, Local<Value> js_name, int id) {
+    isolate_c *py_isolate = isolate_get_object(isolate);
     PyObject *name;
     if (js_name.IsEmpty() || js_name->IsUndefined()) {
         name = javascript;
         Py_INCREF(name);
     } else {
-        name = py_from_js(js_name, compile_context.Get(isolate));
+        name = py_from_js(js_name, py_isolate->compile_context.Get(isolate));
         PyErr_PROPAGATE(name);
     }
     if (id == 0) {
         return name;
     }
-    PyObject *script_name = PyUnicode_FromFormat("%S-%d", name, id);
+    PyObject *script_name;
+    if (py_isolate == default_isolate) {
+        script_name = PyUnicode_FromFormat("%S-%d", name, id);
+    } else {
+        script_name = PyUnicode_FromFormat("%S-%d.%d", name, py_isolate->index, id);
+    }
     Py_DECREF(name);
     return script_name;
 }
 
 PyObject *script_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
-    IN_V8;
-    IN_CONTEXT(compile_context.Get(isolate));
-    JS_TRY
-
-    static const char *keywords[] = {"source", "filename", NULL};
+    static const char *keywords[] = {"source", "filename", "isolate", "code_cache", "eager", NULL};
     PyObject *source;
     PyObject *filename = Py_None;
-    if (PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", (char **) keywords, &source, &filename) < 0) {
+    PyObject *isolate_spec = Py_None;
+    PyObject *code_cache = Py_None;
+    PyObject *eager = Py_False;
+    int cache_mode = SCRIPT_CACHE_DIR;
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOOO", (char **) keywords,
+                &source, &filename, &isolate_spec, &code_cache, &eager) < 0) {
         return NULL;
     }
     if (!PyString_Check(source)) {
@@ -89,54 +177,852 @@ PyObject *script_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
         PyErr_SetString(PyExc_TypeError, "filename must be a string or None");
         return NULL;
     }
+    if (code_cache == Py_True) {
+        cache_mode = SCRIPT_CACHE_PRODUCE;
+        code_cache = Py_None;
+    } else if (code_cache == Py_False) {
+        cache_mode = SCRIPT_CACHE_NONE;
+        code_cache = Py_None;
+    } else if (code_cache != Py_None && !PyBytes_Check(code_cache)) {
+        PyErr_SetString(PyExc_TypeError, "code_cache must be bytes, a bool or None");
+        return NULL;
+    }
+    bool compile_eager = PyObject_IsTrue(eager) == 1;
+#if !EAGER_COMPILE_SUPPORTED
+    if (compile_eager) {
+        if (PyErr_WarnEx(PyExc_RuntimeWarning, "eager=True needs V8 6.6 or newer, compiling lazily", 1) < 0) {
+            return NULL;
+        }
+        compile_eager = false;
+    }
+#endif
+    isolate_c *py_isolate = isolate_choose(isolate_spec);
+    PyErr_PROPAGATE(py_isolate);
+
+    PyObject *result = script_new_in_isolate(type, py_isolate, source, filename,
+            code_cache == Py_None ? NULL : code_cache, cache_mode, compile_eager);
+    Py_DECREF(py_isolate);
+    return result;
+}
+
+// Path of the on-disk cache for source, or NULL without an exception if
+// there's no cache dir
+static PyObject *code_cache_path(PyObject *source) {
+    if (code_cache_dir == NULL) {
+        return NULL;
+    }
+    PyObject *encoded;
+    if (PyUnicode_Check(source)) {
+        encoded = PyUnicode_AsUTF8String(source);
+        PyErr_PROPAGATE(encoded);
+    } else {
+        encoded = source;
+        Py_INCREF(encoded);
+    }
+    PyObject *hash = PyObject_CallFunctionObjArgs(sha1_function, encoded, NULL);
+    Py_DECREF(encoded);
+    PyErr_PROPAGATE(hash);
+    PyObject *digest = PyObject_CallMethod(hash, (char *) "digest", NULL);
+    Py_DECREF(hash);
+    PyErr_PROPAGATE(digest);
+
+    char name[64];
+    char *end = name;
+    const unsigned char *bytes = (const unsigned char *) PyBytes_AS_STRING(digest);
+    for (Py_ssize_t i = 0; i < PyBytes_GET_SIZE(digest) && i < 20; i++) {
+        end += sprintf(end, "%02x", bytes[i]);
+    }
+    sprintf(end, "-%08x.jscache", ScriptCompiler::CachedDataVersionTag());
+    Py_DECREF(digest);
+
+    return PyObject_CallMethod(os_path_module, (char *) "join", (char *) "Os", code_cache_dir, name);
+}
+
+// Returns the file's contents, or NULL without an exception if it can't be read
+static PyObject *code_cache_read(PyObject *path) {
+    PyObject *file = PyObject_CallMethod(io_module, (char *) "open", (char *) "Os", path, "rb");
+    if (file == NULL) {
+        PyErr_Clear();
+        return NULL;
+    }
+    PyObject *data = PyObject_CallMethod(file, (char *) "read", NULL);
+    PyObject *closed = PyObject_CallMethod(file, (char *) "close", NULL);
+    Py_XDECREF(closed);
+    Py_DECREF(file);
+    if (data == NULL || !PyBytes_Check(data)) {
+        Py_XDECREF(data);
+        PyErr_Clear();
+        return NULL;
+    }
+    return data;
+}
+
+// The cache is only an optimization, so failing to write it is not an error.
+// It's written next to where it goes and renamed into place, so workers
+// starting at the same time never read half of one.
+static void code_cache_write(PyObject *path, PyObject *data) {
+    PyObject *pid = PyObject_CallMethod(os_module, (char *) "getpid", NULL);
+    if (pid == NULL) {
+        PyErr_Clear();
+        return;
+    }
+    PyObject *temp_path = PyUnicode_FromFormat("%S.%S.%lu.tmp", path, pid, PyThread_get_thread_ident());
+    Py_DECREF(pid);
+    if (temp_path == NULL) {
+        PyErr_Clear();
+        return;
+    }
+    PyObject *file = PyObject_CallMethod(io_module, (char *) "open", (char *) "Os", temp_path, "wb");
+    if (file == NULL) {
+        Py_DECREF(temp_path);
+        PyErr_Clear();
+        return;
+    }
+    PyObject *written = PyObject_CallMethod(file, (char *) "write", (char *) "O", data);
+    PyObject *closed = PyObject_CallMethod(file, (char *) "close", NULL);
+    Py_DECREF(file);
+    PyObject *renamed = NULL;
+    if (written != NULL && closed != NULL) {
+        // rename doesn't replace an existing file on Windows, replace does but not on Python 2
+        const char *rename = PyObject_HasAttrString(os_module, "replace") ? "replace" : "rename";
+        renamed = PyObject_CallMethod(os_module, (char *) rename, (char *) "OO", temp_path, path);
+    }
+    if (renamed == NULL) {
+        PyErr_Clear();
+        PyObject *removed = PyObject_CallMethod(os_module, (char *) "remove", (char *) "O", temp_path);
+        Py_XDECREF(removed);
+    }
+    Py_XDECREF(written);
+    Py_XDECREF(closed);
+    Py_XDECREF(renamed);
+    Py_DECREF(temp_path);
+    PyErr_Clear();
+}
+
+// For a cache V8 rejected and that can't be replaced, so the next start
+// makes a new one instead of reading and rejecting it again
+static void code_cache_remove(PyObject *path) {
+    PyObject *removed = PyObject_CallMethod(os_module, (char *) "remove", (char *) "O", path);
+    Py_XDECREF(removed);
+    PyErr_Clear();
+}
+
+PyObject *script_new_in_isolate(PyTypeObject *type, isolate_c *py_isolate, PyObject *source, PyObject *filename,
+        PyObject *code_cache, int cache_mode, bool eager, Local<Context> in_context) {
+    PyObject *cache_path = NULL;
+    if (code_cache == NULL && cache_mode != SCRIPT_CACHE_NONE) {
+        cache_path = code_cache_path(source);
+        if (cache_path == NULL && PyErr_Occurred()) {
+            return NULL;
+        }
+        if (cache_path != NULL) {
+            code_cache = code_cache_read(cache_path);
+        }
+    } else {
+        Py_INCREF(code_cache);
+    }
+    // from here on code_cache is owned or NULL
 
-    MaybeLocal<UnboundScript> maybe_script = script_compile(context, source, filename);
+    IN_V8(py_isolate->isolate);
+    IN_CONTEXT(in_context.IsEmpty() ? py_isolate->compile_context.Get(isolate) : in_context);
+    JS_TRY
+
+    bool cache_rejected = false;
+    // only set on V8 that can't make a cache after the fact, and only asked
+    // for when it's going to be used, since making one serializes the script
+    PyObject *produced_cache = NULL;
+    bool produce = cache_mode == SCRIPT_CACHE_PRODUCE || cache_path != NULL;
+    MaybeLocal<UnboundScript> maybe_script = script_compile(context, source, filename, code_cache,
+            &cache_rejected, eager, produce ? &produced_cache : NULL);
+    if (tc.HasCaught()) {
+        Py_XDECREF(cache_path);
+        Py_XDECREF(code_cache);
+        Py_XDECREF(produced_cache);
+    }
     PY_PROPAGATE_JS;
     Local<UnboundScript> script = maybe_script.ToLocalChecked();
-    PyObject *script_name = construct_script_name(script->GetScriptName(), script->GetId());
-    PyErr_PROPAGATE(script_name);
+    if (cache_rejected) {
+        Py_CLEAR(code_cache);
+    }
+    if (code_cache == NULL) {
+        code_cache = produced_cache;
+    } else {
+        Py_XDECREF(produced_cache);
+    }
+    if (cache_path != NULL) {
+        if (code_cache == NULL) {
+            code_cache = script_create_code_cache(script, js_from_py(source, context).As<String>());
+            if (code_cache != NULL && code_cache != Py_None) {
+                code_cache_write(cache_path, code_cache);
+            } else if (cache_rejected) {
+                code_cache_remove(cache_path);
+            }
+            PyErr_Clear();
+        }
+        Py_DECREF(cache_path);
+    }
+    if (code_cache == Py_None) {
+        Py_CLEAR(code_cache);
+    }
+
+    PyObject *script_name = construct_script_name(isolate, script->GetScriptName(), script->GetId());
+    if (script_name == NULL) {
+        Py_XDECREF(code_cache);
+        return NULL;
+    }
     if (PySequence_Contains(scripts_by_name, script_name)) {
-        return PyObject_GetItem(scripts_by_name, script_name);
+        PyObject *existing = PyObject_GetItem(scripts_by_name, script_name);
+        Py_DECREF(script_name);
+        Py_XDECREF(code_cache);
+        return existing;
     }
 
     script_c *self = (script_c *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        Py_DECREF(script_name);
+        Py_XDECREF(code_cache);
+        return NULL;
+    }
     self->script.Reset(isolate, script);
+    Py_INCREF(py_isolate);
+    self->py_isolate = py_isolate;
     self->script_name = script_name;
     Py_INCREF(source);
     self->source = source;
+    self->code_cache = code_cache;
+    self->code_cache_rejected = cache_rejected;
+    self->eager = eager;
 
     if (PyObject_SetItem(scripts_by_name, self->script_name, (PyObject *) self) < 0) return NULL;
 
     return (PyObject *) self;
 }
 
-MaybeLocal<UnboundScript> script_compile(Local<Context> context, PyObject *source, PyObject *filename) {
+// V8 before 6.5 can only make a code cache while compiling, and only when it
+// actually compiles: once the source is in the isolate's compilation cache,
+// compiling it again hands back the same script and produces nothing
+#define PRODUCE_CACHE_WHILE_COMPILING (V8_MAJOR_VERSION < 6 || (V8_MAJOR_VERSION == 6 && V8_MINOR_VERSION < 5))
+
+static MaybeLocal<UnboundScript> script_compile_source(Isolate *isolate, ScriptCompiler::Source *js_source,
+        ScriptCompiler::CompileOptions options, bool *rejected, PyObject **produced_cache) {
+    MaybeLocal<UnboundScript> maybe_script = ScriptCompiler::CompileUnbound(isolate, js_source, options);
+    const ScriptCompiler::CachedData *cached_data = js_source->GetCachedData();
+    *rejected = options == ScriptCompiler::kConsumeCodeCache && cached_data->rejected;
+#if PRODUCE_CACHE_WHILE_COMPILING
+    if (options == ScriptCompiler::kProduceCodeCache && cached_data != NULL && produced_cache != NULL) {
+        // the Source owns the produced data, so copy it out before it goes
+        *produced_cache = PyBytes_FromStringAndSize((const char *) cached_data->data, cached_data->length);
+        PyErr_Clear();
+    }
+#endif
+    return maybe_script;
+}
+
+MaybeLocal<UnboundScript> script_compile(Local<Context> context, PyObject *source, PyObject *filename,
+        PyObject *code_cache, bool *cache_rejected, bool eager, PyObject **produced_cache) {
+    Isolate *isolate = context->GetIsolate();
     EscapableHandleScope hs(isolate);
     MaybeLocal<UnboundScript> maybe_script;
+    Local<String> js_source_string = js_from_py(source, context).As<String>();
+
+    // the Source deletes the CachedData, but not the buffer, which stays owned by code_cache
+    ScriptCompiler::CachedData *cached_data = NULL;
+    ScriptCompiler::CompileOptions options = ScriptCompiler::kNoCompileOptions;
+    if (code_cache != NULL) {
+        cached_data = new ScriptCompiler::CachedData(
+                (const uint8_t *) PyBytes_AS_STRING(code_cache), (int) PyBytes_GET_SIZE(code_cache));
+        options = ScriptCompiler::kConsumeCodeCache;
+    } else if (eager) {
+#if EAGER_COMPILE_SUPPORTED
+        options = ScriptCompiler::kEagerCompile;
+#endif
+    }
+#if PRODUCE_CACHE_WHILE_COMPILING
+    if (code_cache == NULL && produced_cache != NULL) {
+        options = ScriptCompiler::kProduceCodeCache;
+    }
+#endif
+    bool rejected;
+
     // fucking god / c++
     if (filename != Py_None) {
         ScriptOrigin origin(js_from_py(filename, context));
-        ScriptCompiler::Source js_source(js_from_py(source, context).As<String>(), origin);
-        maybe_script = ScriptCompiler::CompileUnbound(isolate, &js_source);
+        ScriptCompiler::Source js_source(js_source_string, origin, cached_data);
+        maybe_script = script_compile_source(isolate, &js_source, options, &rejected, produced_cache);
     } else {
-        ScriptCompiler::Source js_source(js_from_py(source, context).As<String>());
-        maybe_script = ScriptCompiler::CompileUnbound(isolate, &js_source);
+        ScriptCompiler::Source js_source(js_source_string, cached_data);
+        maybe_script = script_compile_source(isolate, &js_source, options, &rejected, produced_cache);
+    }
+    if (cache_rejected != NULL) {
+        *cache_rejected = rejected;
     }
     if (maybe_script.IsEmpty())
         return maybe_script;
     return hs.Escape(maybe_script.ToLocalChecked());
 }
 
+PyObject *script_create_code_cache(Local<UnboundScript> script, Local<String> source) {
+#if V8_MAJOR_VERSION > 6 || (V8_MAJOR_VERSION == 6 && V8_MINOR_VERSION >= 5)
+    ScriptCompiler::CachedData *cached_data = ScriptCompiler::CreateCodeCache(script, source);
+    if (cached_data == NULL) {
+        Py_RETURN_NONE;
+    }
+    PyObject *data = PyBytes_FromStringAndSize((const char *) cached_data->data, cached_data->length);
+    delete cached_data;
+    return data;
+#else
+    // no CreateCodeCache yet, so compile it again and have V8 produce the
+    // cache. Scripts from Script() already made theirs while compiling; this
+    // is for the rest, and gives None if the source is still in the
+    // compilation cache, since then V8 doesn't compile anything.
+    Isolate *isolate = source->GetIsolate();
+    HandleScope hs(isolate);
+    ScriptCompiler::Source js_source(source);
+    if (ScriptCompiler::CompileUnbound(isolate, &js_source, ScriptCompiler::kProduceCodeCache).IsEmpty()) {
+        Py_RETURN_NONE;
+    }
+    const ScriptCompiler::CachedData *produced = js_source.GetCachedData();
+    if (produced == NULL) {
+        Py_RETURN_NONE;
+    }
+    return PyBytes_FromStringAndSize((const char *) produced->data, produced->length);
+#endif
+}
+
+PyObject *script_get_code_cache(script_c *self, void *shit) {
+    if (self->code_cache == NULL) {
+        IN_V8(self->py_isolate->isolate);
+        IN_CONTEXT(self->py_isolate->compile_context.Get(isolate));
+        PyObject *code_cache = script_create_code_cache(self->script.Get(isolate),
+                js_from_py(self->source, context).As<String>());
+        PyErr_PROPAGATE(code_cache);
+        if (code_cache == Py_None) {
+            return code_cache;
+        }
+        self->code_cache = code_cache;
+    }
+    Py_INCREF(self->code_cache);
+    return self->code_cache;
+}
+
+PyObject *script_get_code_cache_rejected(script_c *self, void *shit) {
+    return PyBool_FromLong(self->code_cache_rejected);
+}
+
+PyObject *script_get_eager(script_c *self, void *shit) {
+    return PyBool_FromLong(self->eager);
+}
+
+PyObject *script_set_code_cache_dir(PyObject *shit, PyObject *path) {
+    if (path != Py_None && !PyString_Check(path) && !PyUnicode_Check(path)) {
+        PyErr_SetString(PyExc_TypeError, "code cache dir must be a string or None");
+        return NULL;
+    }
+    Py_CLEAR(code_cache_dir);
+    if (path != Py_None) {
+        Py_INCREF(path);
+        code_cache_dir = path;
+    }
+    Py_RETURN_NONE;
+}
+
 void script_dealloc(script_c *self) {
-    self->script.Reset();
+    {
+        IsolateLocker locker(self->py_isolate->isolate);
+        self->script.Reset();
+    }
 
     PyObject_DelItem(scripts_by_name, self->script_name); // can't do anything if this fails
 
     Py_DECREF(self->script_name);
     Py_DECREF(self->source);
+    Py_XDECREF(self->code_cache);
+    Py_DECREF(self->py_isolate);
     Py_TYPE(self)->tp_free((PyObject *) self);
 }
 
+// Streaming compiles parse the source on a background thread while it's
+// being read. V8 pulls the source through a SourceStream, which reads it in
+// chunks from a Python file object and keeps them, because V8 wants the
+// whole source again at the end. The task gets its own thread rather than
+// one of V8's workers, since reading the file needs the GIL and can block.
+#define STREAMING_CHUNK_SIZE (64 * 1024)
+
+class SourceStream : public ScriptCompiler::ExternalSourceStream {
+    public:
+        SourceStream(PyObject *file, PyObject *chunks) : file_(file), chunks_(chunks),
+            error_type_(NULL), error_value_(NULL), error_traceback_(NULL) {}
+
+        size_t GetMoreData(const uint8_t **src) {
+            WITH_GIL;
+            if (error_type_ != NULL) {
+                return 0;
+            }
+            PyObject *chunk = PyObject_CallMethod(file_, (char *) "read", (char *) "n", (Py_ssize_t) STREAMING_CHUNK_SIZE);
+            if (chunk != NULL && PyUnicode_Check(chunk)) {
+                // file opened in text mode
+                PyObject *encoded = PyUnicode_AsUTF8String(chunk);
+                Py_DECREF(chunk);
+                chunk = encoded;
+            }
+            if (chunk != NULL && !PyBytes_Check(chunk)) {
+                Py_DECREF(chunk);
+                PyErr_SetString(PyExc_TypeError, "read() must return bytes or str");
+                chunk = NULL;
+            }
+            if (chunk == NULL || PyList_Append(chunks_, chunk) < 0) {
+                Py_XDECREF(chunk);
+                PyErr_Fetch(&error_type_, &error_value_, &error_traceback_);
+                return 0;
+            }
+            size_t length = PyBytes_GET_SIZE(chunk);
+            // V8 owns and deletes the data
+            uint8_t *data = new uint8_t[length];
+            memcpy(data, PyBytes_AS_STRING(chunk), length);
+            Py_DECREF(chunk);
+            *src = data;
+            return length;
+        }
+
+        // Raises whatever went wrong while reading, returns false if nothing did
+        bool restore_error() {
+            if (error_type_ == NULL) {
+                return false;
+            }
+            PyErr_Restore(error_type_, error_value_, error_traceback_);
+            error_type_ = error_value_ = error_traceback_ = NULL;
+            return true;
+        }
+
+    private:
+        PyObject *file_;
+        PyObject *chunks_;
+        PyObject *error_type_;
+        PyObject *error_value_;
+        PyObject *error_traceback_;
+};
+
+struct StreamingCompile {
+    isolate_c *py_isolate;
+    PyObject *future;
+    PyObject *file;
+    bool close_file;
+    PyObject *filename;
+    PyObject *chunks;
+    SourceStream *stream;
+    ScriptCompiler::StreamedSource *source;
+    ScriptCompiler::ScriptStreamingTask *task;
+};
+
+// Compiles a StreamedSource whose streaming task has finished, into a Script
+static PyObject *script_from_streamed(isolate_c *py_isolate, ScriptCompiler::StreamedSource *streamed,
+        PyObject *source, PyObject *filename) {
+    IN_V8(py_isolate->isolate);
+    IN_CONTEXT(py_isolate->compile_context.Get(isolate));
+    JS_TRY
+
+    Local<String> js_source = js_from_py(source, context).As<String>();
+    MaybeLocal<Script> maybe_script;
+    if (filename != Py_None) {
+        ScriptOrigin origin(js_from_py(filename, context));
+        maybe_script = ScriptCompiler::Compile(context, streamed, js_source, origin);
+    } else {
+        ScriptOrigin origin(Undefined(isolate));
+        maybe_script = ScriptCompiler::Compile(context, streamed, js_source, origin);
+    }
+    PY_PROPAGATE_JS;
+    Local<UnboundScript> script = maybe_script.ToLocalChecked()->GetUnboundScript();
+
+    PyObject *script_name = construct_script_name(isolate, script->GetScriptName(), script->GetId());
+    PyErr_PROPAGATE(script_name);
+    if (PySequence_Contains(scripts_by_name, script_name)) {
+        PyObject *existing = PyObject_GetItem(scripts_by_name, script_name);
+        Py_DECREF(script_name);
+        return existing;
+    }
+    script_c *self = (script_c *) script_type.tp_alloc(&script_type, 0);
+    if (self == NULL) {
+        Py_DECREF(script_name);
+        return NULL;
+    }
+    self->script.Reset(isolate, script);
+    Py_INCREF(py_isolate);
+    self->py_isolate = py_isolate;
+    self->script_name = script_name;
+    Py_INCREF(source);
+    self->source = source;
+    self->code_cache = NULL;
+    self->code_cache_rejected = false;
+    self->eager = false;
+    if (PyObject_SetItem(scripts_by_name, self->script_name, (PyObject *) self) < 0) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    return (PyObject *) self;
+}
+
+// Finishes the compile on the streaming thread, with the GIL
+static PyObject *streaming_finish(StreamingCompile *compile) {
+    if (compile->stream->restore_error()) {
+        return NULL;
+    }
+    PyObject *empty = PyBytes_FromStringAndSize(NULL, 0);
+    PyErr_PROPAGATE(empty);
+    PyObject *joined = PyObject_CallMethod(empty, (char *) "join", (char *) "O", compile->chunks);
+    Py_DECREF(empty);
+    PyErr_PROPAGATE(joined);
+    PyObject *source = PyUnicode_DecodeUTF8(PyBytes_AS_STRING(joined), PyBytes_GET_SIZE(joined), NULL);
+    Py_DECREF(joined);
+    PyErr_PROPAGATE(source);
+
+    isolate_c *py_isolate = compile->py_isolate;
+    if (compile->task == NULL) {
+        // V8 couldn't stream it, so it was read in full and gets compiled the normal way
+        PyObject *script = script_new_in_isolate(&script_type, py_isolate, source, compile->filename);
+        Py_DECREF(source);
+        return script;
+    }
+    PyObject *script = script_from_streamed(py_isolate, compile->source, source, compile->filename);
+    Py_DECREF(source);
+    return script;
+}
+
+static void streaming_thread(StreamingCompile *compile) {
+    if (compile->task != NULL) {
+        compile->task->Run();
+    } else {
+        const uint8_t *data;
+        size_t length;
+        while ((length = compile->stream->GetMoreData(&data)) > 0) {
+            delete[] data;
+        }
+    }
+
+    WITH_GIL;
+    PyObject *script = streaming_finish(compile);
+    PyObject *result;
+    if (script != NULL) {
+        result = PyObject_CallMethod(compile->future, (char *) "set_result", (char *) "O", script);
+        Py_DECREF(script);
+    } else {
+        PyObject *exc_type, *exc_value, *exc_traceback;
+        PyErr_Fetch(&exc_type, &exc_value, &exc_traceback);
+        PyErr_NormalizeException(&exc_type, &exc_value, &exc_traceback);
+        result = PyObject_CallMethod(compile->future, (char *) "set_exception", (char *) "O", exc_value);
+        Py_XDECREF(exc_type);
+        Py_XDECREF(exc_value);
+        Py_XDECREF(exc_traceback);
+    }
+    if (result == NULL) {
+        PyErr_WriteUnraisable(compile->future);
+    }
+    Py_XDECREF(result);
+
+    if (compile->close_file) {
+        PyObject *closed = PyObject_CallMethod(compile->file, (char *) "close", NULL);
+        if (closed == NULL) {
+            PyErr_Clear();
+        }
+        Py_XDECREF(closed);
+    }
+    {
+        IsolateLocker locker(compile->py_isolate->isolate);
+        delete compile->task;
+        // also deletes the stream
+        delete compile->source;
+    }
+    Py_DECREF(compile->py_isolate);
+    Py_DECREF(compile->future);
+    Py_DECREF(compile->file);
+    Py_DECREF(compile->filename);
+    Py_DECREF(compile->chunks);
+    delete compile;
+}
+
+// Script.compile_async(source_or_file, filename=None, isolate=None) takes
+// source as a string, an open file (binary or text), or a path-like object,
+// and returns a concurrent.futures.Future of the Script.
+PyObject *script_compile_async(PyObject *cls, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = {"source_or_file", "filename", "isolate", NULL};
+    PyObject *source_or_file;
+    PyObject *filename = Py_None;
+    PyObject *isolate_spec = Py_None;
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "O|OO", (char **) keywords,
+                &source_or_file, &filename, &isolate_spec) < 0) {
+        return NULL;
+    }
+    if (filename != Py_None && !PyString_Check(filename)) {
+        PyErr_SetString(PyExc_TypeError, "filename must be a string or None");
+        return NULL;
+    }
+
+    PyObject *file;
+    bool close_file = true;
+    if (PyString_Check(source_or_file) || PyUnicode_Check(source_or_file)) {
+        PyObject *encoded = PyUnicode_Check(source_or_file) ?
+            PyUnicode_AsUTF8String(source_or_file) : (Py_INCREF(source_or_file), source_or_file);
+        PyErr_PROPAGATE(encoded);
+        file = PyObject_CallMethod(io_module, (char *) "BytesIO", (char *) "O", encoded);
+        Py_DECREF(encoded);
+    } else if (PyObject_HasAttrString(source_or_file, "read")) {
+        file = source_or_file;
+        Py_INCREF(file);
+        close_file = false;
+    } else {
+        file = PyObject_CallMethod(io_module, (char *) "open", (char *) "Os", source_or_file, "rb");
+    }
+    PyErr_PROPAGATE(file);
+    if (filename == Py_None && !PyString_Check(source_or_file) && !PyUnicode_Check(source_or_file)) {
+        // files know where they came from
+        PyObject *name = PyObject_GetAttrString(file, "name");
+        if (name != NULL && PyString_Check(name)) {
+            filename = name;
+        } else {
+            // BytesIO has no name, and files opened from an fd or a bytes
+            // path have one that isn't a str
+            PyErr_Clear();
+            Py_XDECREF(name);
+            filename = Py_None;
+            Py_INCREF(filename);
+        }
+    } else {
+        Py_INCREF(filename);
+    }
+    // from here on filename is owned
+
+    PyObject *futures_module = PyImport_ImportModule("concurrent.futures");
+    PyObject *future = futures_module == NULL ? NULL :
+        PyObject_CallMethod(futures_module, (char *) "Future", NULL);
+    Py_XDECREF(futures_module);
+    PyObject *chunks = PyList_New(0);
+    isolate_c *py_isolate = isolate_choose(isolate_spec);
+    if (future == NULL || chunks == NULL || py_isolate == NULL) {
+        Py_XDECREF(future);
+        Py_XDECREF(chunks);
+        Py_XDECREF(py_isolate);
+        Py_DECREF(file);
+        Py_DECREF(filename);
+        return NULL;
+    }
+
+    StreamingCompile *compile = new StreamingCompile();
+    compile->py_isolate = py_isolate;
+    compile->future = future;
+    compile->file = file;
+    compile->close_file = close_file;
+    compile->filename = filename;
+    compile->chunks = chunks;
+    compile->stream = new SourceStream(file, chunks);
+    compile->source = new ScriptCompiler::StreamedSource(compile->stream, ScriptCompiler::StreamedSource::UTF8);
+    {
+        IsolateLocker locker(py_isolate->isolate);
+        compile->task = ScriptCompiler::StartStreamingScript(py_isolate->isolate, compile->source);
+    }
+
+#if PY_VERSION_HEX < 0x03070000
+    // from 3.7 threads are always initialized
+    PyEval_InitThreads();
+#endif
+    Py_INCREF(future);
+    try {
+        std::thread(streaming_thread, compile).detach();
+    } catch (const std::system_error &e) {
+        // run it right here then
+        streaming_thread(compile);
+    }
+    return future;
+}
+
+// Hands V8 a source that's already in memory, in one go. Reading it doesn't
+// touch Python, so the streaming tasks for a batch can all run without the GIL.
+class BufferSourceStream : public ScriptCompiler::ExternalSourceStream {
+    public:
+        explicit BufferSourceStream(const std::string &data) : data_(data), done_(false) {}
+
+        size_t GetMoreData(const uint8_t **src) {
+            if (done_ || data_.empty()) {
+                return 0;
+            }
+            done_ = true;
+            uint8_t *data = new uint8_t[data_.size()];
+            memcpy(data, data_.data(), data_.size());
+            *src = data;
+            return data_.size();
+        }
+
+    private:
+        const std::string &data_;
+        bool done_;
+};
+
+struct BatchCompile {
+    PyObject *source;
+    PyObject *filename;
+    std::string utf8;
+    ScriptCompiler::StreamedSource *streamed;
+    ScriptCompiler::ScriptStreamingTask *task;
+    double seconds;
+};
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void batch_worker(std::vector<BatchCompile> *batch, std::atomic<size_t> *next) {
+    for (size_t i = (*next)++; i < batch->size(); i = (*next)++) {
+        BatchCompile &item = (*batch)[i];
+        if (item.task == NULL) {
+            continue;
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        item.task->Run();
+        item.seconds = seconds_since(start);
+    }
+}
+
+// Script.compile_many(sources, workers=None, isolate=None) parses sources in
+// parallel on worker threads with streaming compile tasks, then finishes them
+// one by one in the isolate. Each source is a string or a (source, filename)
+// tuple. Returns a CompileResult for each, in order. A source that doesn't
+// compile doesn't stop the others.
+PyObject *script_compile_many(PyObject *cls, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = {"sources", "workers", "isolate", NULL};
+    PyObject *sources;
+    int workers = (int) std::thread::hardware_concurrency();
+    PyObject *isolate_spec = Py_None;
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "O|iO", (char **) keywords,
+                &sources, &workers, &isolate_spec) < 0) {
+        return NULL;
+    }
+    if (workers <= 0) {
+        workers = 1;
+    }
+    sources = PySequence_Fast(sources, "sources must be iterable");
+    PyErr_PROPAGATE(sources);
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(sources);
+
+    std::vector<BatchCompile> batch(count);
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(sources, i);
+        PyObject *source = item;
+        PyObject *filename = Py_None;
+        if (PyTuple_Check(item) && !PyArg_ParseTuple(item, "O|O", &source, &filename)) {
+            Py_DECREF(sources);
+            return NULL;
+        }
+        if (!PyString_Check(source) && !PyUnicode_Check(source)) {
+            PyErr_SetString(PyExc_TypeError, "source must be a string");
+            Py_DECREF(sources);
+            return NULL;
+        }
+        if (filename != Py_None && !PyString_Check(filename)) {
+            PyErr_SetString(PyExc_TypeError, "filename must be a string or None");
+            Py_DECREF(sources);
+            return NULL;
+        }
+        PyObject *encoded = PyUnicode_Check(source) ?
+            PyUnicode_AsUTF8String(source) : (Py_INCREF(source), source);
+        if (encoded == NULL) {
+            Py_DECREF(sources);
+            return NULL;
+        }
+        batch[i].source = source;
+        batch[i].filename = filename;
+        batch[i].utf8.assign(PyBytes_AS_STRING(encoded), PyBytes_GET_SIZE(encoded));
+        batch[i].streamed = NULL;
+        batch[i].task = NULL;
+        batch[i].seconds = 0;
+        Py_DECREF(encoded);
+    }
+
+    isolate_c *py_isolate = isolate_choose(isolate_spec);
+    if (py_isolate == NULL) {
+        Py_DECREF(sources);
+        return NULL;
+    }
+
+    {
+        IsolateLocker locker(py_isolate->isolate);
+        for (size_t i = 0; i < batch.size(); i++) {
+            batch[i].streamed = new ScriptCompiler::StreamedSource(
+                    new BufferSourceStream(batch[i].utf8), ScriptCompiler::StreamedSource::UTF8);
+            batch[i].task = ScriptCompiler::StartStreamingScript(py_isolate->isolate, batch[i].streamed);
+        }
+    }
+
+    std::atomic<size_t> next(0);
+    Py_BEGIN_ALLOW_THREADS
+    std::vector<std::thread> threads;
+    for (int i = 1; i < workers && (size_t) i < batch.size(); i++) {
+        try {
+            threads.push_back(std::thread(batch_worker, &batch, &next));
+        } catch (const std::system_error &e) {
+            // fewer threads it is
+            break;
+        }
+    }
+    // this thread helps too
+    batch_worker(&batch, &next);
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    Py_END_ALLOW_THREADS
+
+    PyObject *results = PyList_New(count);
+    for (Py_ssize_t i = 0; i < count && results != NULL; i++) {
+        BatchCompile &item = batch[i];
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        PyObject *script;
+        if (item.task != NULL) {
+            script = script_from_streamed(py_isolate, item.streamed, item.source, item.filename);
+        } else {
+            script = script_new_in_isolate(&script_type, py_isolate, item.source, item.filename);
+        }
+        item.seconds += seconds_since(start);
+
+        if (script == NULL && !PyErr_ExceptionMatches((PyObject *) &js_exception_type)) {
+            // only JavaScript errors belong to the script, anything else
+            // (out of memory, Ctrl-C) is the caller's
+            Py_CLEAR(results);
+            break;
+        }
+        PyObject *error = Py_None;
+        Py_INCREF(error);
+        if (script == NULL) {
+            PyObject *exc_type, *exc_traceback;
+            Py_DECREF(error);
+            PyErr_Fetch(&exc_type, &error, &exc_traceback);
+            PyErr_NormalizeException(&exc_type, &error, &exc_traceback);
+            Py_XDECREF(exc_type);
+            Py_XDECREF(exc_traceback);
+            script = Py_None;
+            Py_INCREF(script);
+        }
+        PyObject *result = PyStructSequence_New(&compile_result_type);
+        if (result == NULL) {
+            Py_DECREF(script);
+            Py_DECREF(error);
+            Py_CLEAR(results);
+            break;
+        }
+        PyStructSequence_SET_ITEM(result, 0, script);
+        PyStructSequence_SET_ITEM(result, 1, error);
+        PyStructSequence_SET_ITEM(result, 2, PyFloat_FromDouble(item.seconds));
+        PyList_SET_ITEM(results, i, result);
+    }
+
+    {
+        IsolateLocker locker(py_isolate->isolate);
+        for (size_t i = 0; i < batch.size(); i++) {
+            delete batch[i].task;
+            delete batch[i].streamed;
+        }
+    }
+    Py_DECREF(py_isolate);
+    Py_DECREF(sources);
+    return results;
+}
+
 PyObject *script_loader_get_source(PyObject *self, PyObject *name);
 typedef struct {
     PyObject_HEAD
@@ -6,16 +6,53 @@
 typedef struct {
     PyObject_HEAD
     Persistent<UnboundScript> script;
+    isolate_c *py_isolate;
     PyObject *source;
     PyObject *script_name;
+    // serialized code cache, created on demand
+    PyObject *code_cache;
+    bool code_cache_rejected;
+    // compiled every function up front instead of on first call, only ever
+    // true where EAGER_COMPILE_SUPPORTED
+    bool eager;
     PyObject *weakrefs;
 } script_c;
 extern PyTypeObject script_type;
 
 int script_type_init();
 PyObject *script_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+// kEagerCompile, without it eager compiles are lazy
+#define EAGER_COMPILE_SUPPORTED (V8_MAJOR_VERSION > 6 || (V8_MAJOR_VERSION == 6 && V8_MINOR_VERSION >= 6))
+
+// What to do about code caches when a script isn't given one: use the cache
+// dir if one is set, also make one to hand out as Script.code_cache, or
+// leave caches alone entirely (for throwaway compiles, like Context.eval)
+#define SCRIPT_CACHE_DIR 0
+#define SCRIPT_CACHE_PRODUCE 1
+#define SCRIPT_CACHE_NONE 2
+
+// Compiles in the isolate's compile context, or in_context if given, which
+// is how a debugger attached to a context gets to see the script.
+PyObject *script_new_in_isolate(PyTypeObject *type, isolate_c *py_isolate, PyObject *source, PyObject *filename,
+        PyObject *code_cache = NULL, int cache_mode = SCRIPT_CACHE_DIR, bool eager = false,
+        Local<Context> in_context = Local<Context>());
 void script_dealloc(script_c *self);
+PyObject *script_get_code_cache(script_c *self, void *shit);
+PyObject *script_get_code_cache_rejected(script_c *self, void *shit);
+PyObject *script_get_eager(script_c *self, void *shit);
+PyObject *script_set_code_cache_dir(PyObject *shit, PyObject *path);
+PyObject *script_compile_async(PyObject *cls, PyObject *args, PyObject *kwargs);
+PyObject *script_compile_many(PyObject *cls, PyObject *args, PyObject *kwargs);
 
-PyObject *construct_script_name(Local<Value> js_name, int id);
-MaybeLocal<UnboundScript> script_compile(Local<Context> context, PyObject *source, PyObject *filename);
+PyObject *construct_script_name(Isolate *isolate, Local<Value> js_name, int id);
+// If code_cache is a bytes object it is consumed, and cache_rejected is set
+// if V8 refused it (made by a different V8 version, or for different source).
+// eager compiles every function now rather than when it's first called.
+// On V8 that can only make a code cache while compiling, produced_cache is
+// set to one when code_cache isn't given, if V8 made one.
+MaybeLocal<UnboundScript> script_compile(Local<Context> context, PyObject *source, PyObject *filename,
+        PyObject *code_cache = NULL, bool *cache_rejected = NULL, bool eager = false,
+        PyObject **produced_cache = NULL);
+// Returns the serialized code cache as bytes, or None if V8 can't make one
+PyObject *script_create_code_cache(Local<UnboundScript> script, Local<String> source);
 extern PyObject *script_loader;
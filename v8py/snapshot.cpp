@@ -0,0 +1,160 @@
+#include <Python.h>
+#include "v8py.h"
+#include <v8.h>
+
+#include "context.h"
+#include "convert.h"
+#include "pyclass.h"
+#include "pyfunction.h"
+#include "snapshot.h"
+
+using namespace v8;
+
+intptr_t snapshot_external_references[] = {
+    (intptr_t) py_function_callback,
+    (intptr_t) py_class_construct_callback,
+    (intptr_t) py_class_method_callback,
+    (intptr_t) named_getter,
+    (intptr_t) named_setter,
+    (intptr_t) named_query,
+    (intptr_t) named_deleter,
+    (intptr_t) named_enumerator,
+    (intptr_t) indexed_getter,
+    (intptr_t) indexed_setter,
+    (intptr_t) indexed_query,
+    (intptr_t) indexed_deleter,
+    (intptr_t) indexed_enumerator,
+    (intptr_t) py_class_property_getter,
+    (intptr_t) py_class_property_setter,
+    (intptr_t) js_promise_fulfilled_callback,
+    (intptr_t) js_promise_rejected_callback,
+    0,
+};
+
+PyGetSetDef snapshot_getset[] = {
+    {(char *) "blob", (getter) snapshot_get_blob, NULL, NULL, NULL},
+    {NULL},
+};
+PyTypeObject snapshot_type = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+int snapshot_type_init() {
+    snapshot_type.tp_name = "v8py.Snapshot";
+    snapshot_type.tp_basicsize = sizeof(snapshot_c);
+    snapshot_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    snapshot_type.tp_doc = "";
+    snapshot_type.tp_new = (newfunc) snapshot_new;
+    snapshot_type.tp_dealloc = (destructor) snapshot_dealloc;
+    snapshot_type.tp_getset = snapshot_getset;
+    return PyType_Ready(&snapshot_type);
+}
+
+// Runs source in a fresh context and serializes the result. The isolate the
+// SnapshotCreator makes has no v8py state at all, so the setup script can't
+// touch Python, and errors are reported as plain strings.
+static PyObject *snapshot_create_blob(PyObject *source, PyObject *filename) {
+    SnapshotCreator creator(snapshot_external_references);
+    Isolate *isolate = creator.GetIsolate();
+    PyObject *error = NULL;
+    {
+        Locker locker(isolate);
+        HandleScope hs(isolate);
+        Local<Context> context = Context::New(isolate);
+        {
+            Context::Scope cs(context);
+            TryCatch tc(isolate);
+            Local<String> js_source = js_from_py(source, context).As<String>();
+            MaybeLocal<Script> script;
+            if (filename != Py_None) {
+                ScriptOrigin origin(js_from_py(filename, context));
+                script = Script::Compile(context, js_source, &origin);
+            } else {
+                script = Script::Compile(context, js_source);
+            }
+            if (!script.IsEmpty()) {
+                script.ToLocalChecked()->Run(context).IsEmpty();
+            }
+            if (tc.HasCaught()) {
+                String::Utf8Value message(tc.Exception());
+                error = PyUnicode_FromString(*message != NULL ? *message : "unknown error");
+            }
+        }
+        creator.SetDefaultContext(context);
+    }
+
+    // the blob has to be created either way, or the creator can't clean up
+    StartupData data = creator.CreateBlob(SnapshotCreator::FunctionCodeHandling::kKeep);
+    PyObject *blob = NULL;
+    if (error != NULL) {
+        PyErr_SetObject(PyExc_ValueError, error);
+        Py_DECREF(error);
+    } else if (data.data == NULL) {
+        PyErr_SetString(PyExc_ValueError, "V8 could not create the snapshot");
+    } else {
+        blob = PyBytes_FromStringAndSize(data.data, data.raw_size);
+    }
+    delete[] data.data;
+    return blob;
+}
+
+PyObject *snapshot_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    static const char *keywords[] = {"source", "filename", "blob", NULL};
+    PyObject *source = Py_None;
+    PyObject *filename = Py_None;
+    PyObject *blob = Py_None;
+    if (PyArg_ParseTupleAndKeywords(args, kwargs, "|OOO", (char **) keywords, &source, &filename, &blob) < 0) {
+        return NULL;
+    }
+    if ((source == Py_None) == (blob == Py_None)) {
+        PyErr_SetString(PyExc_TypeError, "need exactly one of source or blob");
+        return NULL;
+    }
+    if (source != Py_None && !PyString_Check(source)) {
+        PyErr_SetString(PyExc_TypeError, "source must be a string");
+        return NULL;
+    }
+    if (filename != Py_None && !PyString_Check(filename)) {
+        PyErr_SetString(PyExc_TypeError, "filename must be a string or None");
+        return NULL;
+    }
+    if (blob != Py_None && !PyBytes_Check(blob)) {
+        PyErr_SetString(PyExc_TypeError, "blob must be bytes");
+        return NULL;
+    }
+
+    if (source != Py_None) {
+        blob = snapshot_create_blob(source, filename);
+        PyErr_PROPAGATE(blob);
+    } else {
+        Py_INCREF(blob);
+    }
+
+    snapshot_c *self = (snapshot_c *) type->tp_alloc(type, 0);
+    if (self == NULL) {
+        Py_DECREF(blob);
+        return NULL;
+    }
+    self->blob = blob;
+    self->py_isolate = NULL;
+    return (PyObject *) self;
+}
+
+void snapshot_dealloc(snapshot_c *self) {
+    Py_XDECREF(self->py_isolate);
+    Py_DECREF(self->blob);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+PyObject *snapshot_get_blob(snapshot_c *self, void *shit) {
+    Py_INCREF(self->blob);
+    return self->blob;
+}
+
+isolate_c *snapshot_get_isolate(snapshot_c *self) {
+    if (self->py_isolate == NULL) {
+        self->py_isolate = isolate_create(self->blob);
+        PyErr_PROPAGATE(self->py_isolate);
+    }
+    Py_INCREF(self->py_isolate);
+    return self->py_isolate;
+}
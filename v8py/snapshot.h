@@ -0,0 +1,36 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <Python.h>
+#include <v8.h>
+
+#include "isolate.h"
+
+using namespace v8;
+
+// A Snapshot is a V8 startup snapshot of a context that has already run a
+// setup script. Isolates created from it start every new context with the
+// setup script's globals in place, which is much cheaper than running it.
+typedef struct {
+    PyObject_HEAD
+    // the serialized heap, as bytes
+    PyObject *blob;
+    // isolate shared by Context(snapshot=...), created on demand
+    isolate_c *py_isolate;
+} snapshot_c;
+extern PyTypeObject snapshot_type;
+int snapshot_type_init();
+
+PyObject *snapshot_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void snapshot_dealloc(snapshot_c *self);
+PyObject *snapshot_get_blob(snapshot_c *self, void *shit);
+
+// Returns a new reference to the snapshot's shared isolate
+isolate_c *snapshot_get_isolate(snapshot_c *self);
+
+// Every native callback v8py hands to V8. A snapshot records functions as
+// indexes into this list, so it has to be the same when the snapshot is
+// created and when it's deserialized. Only ever append to it.
+extern intptr_t snapshot_external_references[];
+
+#endif
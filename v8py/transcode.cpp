@@ -0,0 +1,357 @@
+#include <string.h>
+
+#include "transcode.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TRANSCODE_SSE2
+#include <emmintrin.h>
+#endif
+
+// GCC and Clang can compile AVX2 functions into a file that isn't built with
+// -mavx2, so the extension still loads on CPUs without it
+#if defined(TRANSCODE_SSE2) && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define TRANSCODE_AVX2
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+static bool use_avx2 = false;
+
+int transcode_init() {
+#ifdef TRANSCODE_AVX2
+    __builtin_cpu_init();
+    use_avx2 = __builtin_cpu_supports("avx2");
+#endif
+    return 0;
+}
+
+static inline int utf16_class(uint16_t high) {
+    if (high & 0xff00) {
+        return UTF16_BMP;
+    }
+    if (high & 0x80) {
+        return UTF16_LATIN1;
+    }
+    return UTF16_ASCII;
+}
+
+// Takes one code point, or two code units if they're a surrogate pair
+static inline void decode_one(const uint16_t *data, size_t length, size_t *i, uint32_t *out, size_t *n) {
+    uint32_t unit = data[*i];
+    if ((unit & 0xfc00) == 0xd800 && *i + 1 < length && (data[*i + 1] & 0xfc00) == 0xdc00) {
+        out[(*n)++] = 0x10000 + ((unit - 0xd800) << 10) + (data[*i + 1] - 0xdc00);
+        *i += 2;
+    } else {
+        out[(*n)++] = unit;
+        *i += 1;
+    }
+}
+
+static inline size_t encode_one(uint32_t c, uint16_t *out) {
+    if (c < 0x10000) {
+        out[0] = (uint16_t) c;
+        return 1;
+    }
+    c -= 0x10000;
+    out[0] = (uint16_t) (0xd800 + (c >> 10));
+    out[1] = (uint16_t) (0xdc00 + (c & 0x3ff));
+    return 2;
+}
+
+// Scalar versions, also used for whatever's left after the vector loops
+
+static bool latin1_is_ascii_scalar(const uint8_t *data, size_t length) {
+    uint64_t high = 0;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        high |= word;
+    }
+    for (; i < length; i++) {
+        high |= data[i];
+    }
+    return (high & UINT64_C(0x8080808080808080)) == 0;
+}
+
+static int utf16_classify_scalar(const uint16_t *data, size_t length, uint16_t high) {
+    for (size_t i = 0; i < length; i++) {
+        uint16_t unit = data[i];
+        if ((unit & 0xf800) == 0xd800) {
+            return UTF16_SURROGATES;
+        }
+        high |= unit;
+    }
+    return utf16_class(high);
+}
+
+static void utf16_to_latin1_scalar(const uint16_t *data, size_t length, uint8_t *out) {
+    for (size_t i = 0; i < length; i++) {
+        out[i] = (uint8_t) data[i];
+    }
+}
+
+static size_t utf16_to_ucs4_scalar(const uint16_t *data, size_t length, uint32_t *out) {
+    size_t i = 0, n = 0;
+    while (i < length) {
+        decode_one(data, length, &i, out, &n);
+    }
+    return n;
+}
+
+static size_t ucs4_to_utf16_scalar(const uint32_t *data, size_t length, uint16_t *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < length; i++) {
+        n += encode_one(data[i], out + n);
+    }
+    return n;
+}
+
+#ifdef TRANSCODE_SSE2
+
+static bool latin1_is_ascii_sse2(const uint8_t *data, size_t length) {
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (data + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i *) (data + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i *) (data + i + 48));
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)))) {
+            return false;
+        }
+    }
+    for (; i + 16 <= length; i += 16) {
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (data + i)))) {
+            return false;
+        }
+    }
+    return latin1_is_ascii_scalar(data + i, length - i);
+}
+
+static int utf16_classify_sse2(const uint16_t *data, size_t length) {
+    const __m128i surrogate_mask = _mm_set1_epi16((short) 0xf800);
+    const __m128i surrogate = _mm_set1_epi16((short) 0xd800);
+    __m128i high = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, surrogate_mask), surrogate))) {
+            return UTF16_SURROGATES;
+        }
+        high = _mm_or_si128(high, v);
+    }
+    uint16_t lanes[8];
+    _mm_storeu_si128((__m128i *) lanes, high);
+    uint16_t high_scalar = 0;
+    for (int lane = 0; lane < 8; lane++) {
+        high_scalar |= lanes[lane];
+    }
+    return utf16_classify_scalar(data + i, length - i, high_scalar);
+}
+
+static void utf16_to_latin1_sse2(const uint16_t *data, size_t length, uint8_t *out) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (data + i + 8));
+        _mm_storeu_si128((__m128i *) (out + i), _mm_packus_epi16(a, b));
+    }
+    utf16_to_latin1_scalar(data + i, length - i, out + i);
+}
+
+static size_t utf16_to_ucs4_sse2(const uint16_t *data, size_t length, uint32_t *out) {
+    const __m128i surrogate_mask = _mm_set1_epi16((short) 0xf800);
+    const __m128i surrogate = _mm_set1_epi16((short) 0xd800);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0, n = 0;
+    while (i + 8 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, surrogate_mask), surrogate))) {
+            // a pair can straddle the end of the block, decode_one takes care of it
+            size_t end = i + 8;
+            while (i < end) {
+                decode_one(data, length, &i, out, &n);
+            }
+            continue;
+        }
+        _mm_storeu_si128((__m128i *) (out + n), _mm_unpacklo_epi16(v, zero));
+        _mm_storeu_si128((__m128i *) (out + n + 4), _mm_unpackhi_epi16(v, zero));
+        i += 8;
+        n += 8;
+    }
+    while (i < length) {
+        decode_one(data, length, &i, out, &n);
+    }
+    return n;
+}
+
+static size_t ucs4_to_utf16_sse2(const uint32_t *data, size_t length, uint16_t *out) {
+    // SSE2 only has a signed 32 to 16 bit pack, so shift everything into the
+    // signed range and back
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16((short) 0x8000);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0, n = 0;
+    for (; i + 8 <= length; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (data + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (data + i + 4));
+        __m128i astral = _mm_srli_epi32(_mm_or_si128(a, b), 16);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(astral, zero)) != 0xffff) {
+            n += ucs4_to_utf16_scalar(data + i, 8, out + n);
+            continue;
+        }
+        __m128i packed = _mm_packs_epi32(_mm_sub_epi32(a, bias32), _mm_sub_epi32(b, bias32));
+        _mm_storeu_si128((__m128i *) (out + n), _mm_add_epi16(packed, bias16));
+        n += 8;
+    }
+    return n + ucs4_to_utf16_scalar(data + i, length - i, out + n);
+}
+
+#endif
+
+#ifdef TRANSCODE_AVX2
+
+AVX2 static bool latin1_is_ascii_avx2(const uint8_t *data, size_t length) {
+    size_t i = 0;
+    for (; i + 128 <= length; i += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (data + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i *) (data + i + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i *) (data + i + 96));
+        if (_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d)))) {
+            return false;
+        }
+    }
+    return latin1_is_ascii_sse2(data + i, length - i);
+}
+
+AVX2 static int utf16_classify_avx2(const uint16_t *data, size_t length) {
+    const __m256i surrogate_mask = _mm256_set1_epi16((short) 0xf800);
+    const __m256i surrogate = _mm256_set1_epi16((short) 0xd800);
+    __m256i high = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (data + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(v, surrogate_mask), surrogate))) {
+            return UTF16_SURROGATES;
+        }
+        high = _mm256_or_si256(high, v);
+    }
+    uint16_t lanes[16];
+    _mm256_storeu_si256((__m256i *) lanes, high);
+    uint16_t high_scalar = 0;
+    for (int lane = 0; lane < 16; lane++) {
+        high_scalar |= lanes[lane];
+    }
+    return utf16_classify_scalar(data + i, length - i, high_scalar);
+}
+
+AVX2 static void utf16_to_latin1_avx2(const uint16_t *data, size_t length, uint8_t *out) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (data + i + 16));
+        // the pack works within 128 bit lanes, put the quarters back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *) (out + i), packed);
+    }
+    utf16_to_latin1_scalar(data + i, length - i, out + i);
+}
+
+AVX2 static size_t utf16_to_ucs4_avx2(const uint16_t *data, size_t length, uint32_t *out) {
+    const __m256i surrogate_mask = _mm256_set1_epi16((short) 0xf800);
+    const __m256i surrogate = _mm256_set1_epi16((short) 0xd800);
+    size_t i = 0, n = 0;
+    while (i + 16 <= length) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (data + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_and_si256(v, surrogate_mask), surrogate))) {
+            size_t end = i + 16;
+            while (i < end) {
+                decode_one(data, length, &i, out, &n);
+            }
+            continue;
+        }
+        _mm256_storeu_si256((__m256i *) (out + n), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)));
+        _mm256_storeu_si256((__m256i *) (out + n + 8), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1)));
+        i += 16;
+        n += 16;
+    }
+    while (i < length) {
+        decode_one(data, length, &i, out, &n);
+    }
+    return n;
+}
+
+AVX2 static size_t ucs4_to_utf16_avx2(const uint32_t *data, size_t length, uint16_t *out) {
+    size_t i = 0, n = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m256i a = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *) (data + i + 8));
+        __m256i astral = _mm256_srli_epi32(_mm256_or_si256(a, b), 16);
+        if (!_mm256_testz_si256(astral, astral)) {
+            n += ucs4_to_utf16_scalar(data + i, 16, out + n);
+            continue;
+        }
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *) (out + n), packed);
+        n += 16;
+    }
+    return n + ucs4_to_utf16_scalar(data + i, length - i, out + n);
+}
+
+#endif
+
+bool latin1_is_ascii(const uint8_t *data, size_t length) {
+#ifdef TRANSCODE_AVX2
+    if (use_avx2) return latin1_is_ascii_avx2(data, length);
+#endif
+#ifdef TRANSCODE_SSE2
+    return latin1_is_ascii_sse2(data, length);
+#else
+    return latin1_is_ascii_scalar(data, length);
+#endif
+}
+
+int utf16_classify(const uint16_t *data, size_t length) {
+#ifdef TRANSCODE_AVX2
+    if (use_avx2) return utf16_classify_avx2(data, length);
+#endif
+#ifdef TRANSCODE_SSE2
+    return utf16_classify_sse2(data, length);
+#else
+    return utf16_classify_scalar(data, length, 0);
+#endif
+}
+
+void utf16_to_latin1(const uint16_t *data, size_t length, uint8_t *out) {
+#ifdef TRANSCODE_AVX2
+    if (use_avx2) return utf16_to_latin1_avx2(data, length, out);
+#endif
+#ifdef TRANSCODE_SSE2
+    utf16_to_latin1_sse2(data, length, out);
+#else
+    utf16_to_latin1_scalar(data, length, out);
+#endif
+}
+
+size_t utf16_to_ucs4(const uint16_t *data, size_t length, uint32_t *out) {
+#ifdef TRANSCODE_AVX2
+    if (use_avx2) return utf16_to_ucs4_avx2(data, length, out);
+#endif
+#ifdef TRANSCODE_SSE2
+    return utf16_to_ucs4_sse2(data, length, out);
+#else
+    return utf16_to_ucs4_scalar(data, length, out);
+#endif
+}
+
+size_t ucs4_to_utf16(const uint32_t *data, size_t length, uint16_t *out) {
+#ifdef TRANSCODE_AVX2
+    if (use_avx2) return ucs4_to_utf16_avx2(data, length, out);
+#endif
+#ifdef TRANSCODE_SSE2
+    return ucs4_to_utf16_sse2(data, length, out);
+#else
+    return ucs4_to_utf16_scalar(data, length, out);
+#endif
+}
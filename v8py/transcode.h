@@ -0,0 +1,39 @@
+#ifndef TRANSCODE_H
+#define TRANSCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Scanning and transcoding loops for the strings that can't be handed
+// between Python and V8 as they are. They use SSE2 on x86-64, AVX2 when the
+// CPU has it, and plain loops everywhere else. None of them touch Python or
+// V8, so they're safe to call without the GIL or an isolate.
+//
+// Lone surrogates are passed through as code points in both directions,
+// which is what JavaScript and Python both allow in a string.
+
+// Picks the fastest implementation for this CPU
+int transcode_init();
+
+bool latin1_is_ascii(const uint8_t *data, size_t length);
+
+// What the narrowest representation of a UTF-16 string is
+#define UTF16_ASCII 0
+#define UTF16_LATIN1 1
+// all of it fits in UCS-2
+#define UTF16_BMP 2
+// there are surrogates, it needs decoding
+#define UTF16_SURROGATES 3
+int utf16_classify(const uint16_t *data, size_t length);
+
+// Only for strings with no code units above 0xff
+void utf16_to_latin1(const uint16_t *data, size_t length, uint8_t *out);
+
+// out needs room for length code points. Returns how many were written,
+// which is less than length if there were surrogate pairs.
+size_t utf16_to_ucs4(const uint16_t *data, size_t length, uint32_t *out);
+
+// out needs room for 2 * length code units. Returns how many were written.
+size_t ucs4_to_utf16(const uint32_t *data, size_t length, uint16_t *out);
+
+#endif
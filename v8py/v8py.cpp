@@ -10,11 +10,15 @@
 #include "pyclass.h"
 #include "jsobject.h"
 #include "debugger.h"
+#include "watchdog.h"
+#include "snapshot.h"
+#include "transcode.h"
+#include "buffer.h"
+#include "live.h"
 
 using namespace v8;
 
 static Platform *current_platform = NULL;
-Isolate *isolate = NULL;
 void initialize_v8() {
     if (current_platform == NULL) {
         V8::InitializeICU();
@@ -23,13 +27,6 @@ void initialize_v8() {
         V8::Initialize();
         // strlen is slow but that doesn't matter much here because this only happens once
         V8::SetFlagsFromString("--expose_gc", strlen("--expose_gc"));
-
-        Isolate::CreateParams create_params;
-        create_params.array_buffer_allocator = ArrayBuffer::Allocator::NewDefaultAllocator();
-        isolate = Isolate::New(create_params);
-        isolate->SetCaptureStackTraceForUncaughtExceptions(true, 100, 
-                // sadly the v8 people screwed up and require me to cast this into to an enum
-                static_cast<StackTrace::StackTraceOptions>(StackTrace::kOverview | StackTrace::kScriptId));
     }
 }
 
@@ -65,7 +62,7 @@ PyObject *construct_new_object(PyObject *self, PyObject *args) {
 
     js_function *function = (js_function*)constructor;
 
-    IN_V8;
+    IN_V8(function->py_isolate->isolate);
     Local<Object> object = function->object.Get(isolate);
     IN_CONTEXT(object->CreationContext())
     JS_TRY
@@ -78,7 +75,7 @@ PyObject *construct_new_object(PyObject *self, PyObject *args) {
     // exclude first argument
     argc--;
 
-    if (!context_setup_timeout(context)) return NULL;
+    CONTEXT_DEADLINE(context);
     MaybeLocal<Value> result;
 #ifndef _WIN32
     // error C2131: expression did not evaluate to a constant on Windows
@@ -87,21 +84,19 @@ PyObject *construct_new_object(PyObject *self, PyObject *args) {
         for (long i = 0; i < argc; i++) {
             argv[i] = js_from_py(PyTuple_GET_ITEM(args, i + 1), context);
         }
-        result = object->CallAsConstructor(argc, argv);
+        CONTEXT_RUN(context, result = object->CallAsConstructor(argc, argv));
     } else {
 #endif
         Local<Value> *argv = new Local<Value>[argc];
         for (long i = 0; i < argc; i++) {
             argv[i] = js_from_py(PyTuple_GET_ITEM(args, i + 1), context);
         }
-        result = object->CallAsConstructor(argc, argv);
+        CONTEXT_RUN(context, result = object->CallAsConstructor(argc, argv));
         delete[] argv;
 #ifndef _WIN32
     }
 #endif
 
-    if (!context_cleanup_timeout(context)) return NULL;
-
     PY_PROPAGATE_JS;
 
     return py_from_js(result.ToLocalChecked(), context);
@@ -112,6 +107,8 @@ static PyMethodDef v8_methods[] = {
     {"unconstructable", mark_unconstructable, METH_O, ""},
     {"current_context", context_get_current, METH_NOARGS, ""},
     {"new", construct_new_object, METH_VARARGS, "Creates a new JavaScript object from a given constructor function"},
+    {"set_code_cache_dir", script_set_code_cache_dir, METH_O, "Keeps script code caches in the given directory, or nowhere if None"},
+    {"set_external_string_threshold", convert_set_external_string_threshold, METH_O, "Shares strings at least this long with JavaScript instead of copying them, never if 0"},
     {NULL},
 };
 
@@ -156,7 +153,6 @@ PyMODINIT_FUNC init_v8py() {
 PyMODINIT_FUNC PyInit__v8py() {
 #endif
     initialize_v8();
-    create_memes_plz_thx();
 
 #if PY_MAJOR_VERSION < 3
     PyObject *module = Py_InitModule("_v8py", v8_methods);
@@ -170,6 +166,30 @@ PyMODINIT_FUNC PyInit__v8py() {
     if (module == NULL) return FAIL;
 
     if (greenstack_init() < 0) return FAIL;
+    if (watchdog_init() < 0) return FAIL;
+    if (transcode_init() < 0) return FAIL;
+
+    if (isolate_type_init() < 0) return FAIL;
+    Py_INCREF(&isolate_type);
+    PyModule_AddObject(module, "Isolate", (PyObject *) &isolate_type);
+    Py_INCREF(default_isolate);
+    PyModule_AddObject(module, "default_isolate", (PyObject *) default_isolate);
+
+    if (isolate_pool_type_init() < 0) return FAIL;
+    Py_INCREF(&isolate_pool_type);
+    PyModule_AddObject(module, "IsolatePool", (PyObject *) &isolate_pool_type);
+
+    if (snapshot_type_init() < 0) return FAIL;
+    Py_INCREF(&snapshot_type);
+    PyModule_AddObject(module, "Snapshot", (PyObject *) &snapshot_type);
+
+    if (buffer_copy_type_init() < 0) return FAIL;
+    Py_INCREF(&buffer_copy_type);
+    PyModule_AddObject(module, "BufferCopy", (PyObject *) &buffer_copy_type);
+
+    if (live_type_init() < 0) return FAIL;
+    Py_INCREF(&live_type);
+    PyModule_AddObject(module, "live", (PyObject *) &live_type);
 
     if (context_type_init() < 0) return FAIL;
     Py_INCREF(&context_type);
@@ -198,6 +218,18 @@ PyMODINIT_FUNC PyInit__v8py() {
     Py_INCREF(&js_function_type);
     PyModule_AddObject(module, "JSFunction", (PyObject *) &js_function_type);
 
+    if (js_buffer_type_init() < 0) return FAIL;
+    Py_INCREF(&js_buffer_type);
+    PyModule_AddObject(module, "JSBuffer", (PyObject *) &js_buffer_type);
+
+    if (js_mapping_type_init() < 0) return FAIL;
+    Py_INCREF(&js_mapping_type);
+    PyModule_AddObject(module, "JSMapping", (PyObject *) &js_mapping_type);
+
+    if (js_sequence_type_init() < 0) return FAIL;
+    Py_INCREF(&js_sequence_type);
+    PyModule_AddObject(module, "JSSequence", (PyObject *) &js_sequence_type);
+
     if (js_exception_type_init() < 0) return FAIL;
     Py_INCREF(&js_exception_type);
     PyModule_AddObject(module, "JSException", (PyObject *) &js_exception_type);
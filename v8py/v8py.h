@@ -13,10 +13,10 @@
 #include "polyfill.h"
 #include "exception.h"
 #include "kappa.h"
+#include "isolate.h"
 
 using namespace v8;
 
-extern Isolate *isolate;
 extern PyObject *null_object;
 #define STRING_BUFFER_SIZE 512
 static uint16_t string_buffer[STRING_BUFFER_SIZE] = {};
@@ -30,14 +30,65 @@ static uint16_t string_buffer[STRING_BUFFER_SIZE] = {};
         printf("%s\n", *value); \
     }
 
-#define IN_V8 \
-    Locker locker(isolate); \
+// JavaScript can run with the GIL released (see Context.release_gil), and the
+// thread running it needs the GIL back whenever it calls into Python. So
+// nobody may wait for that isolate while holding the GIL, or the two threads
+// deadlock. IsolateLocker drops the GIL while it waits for the isolate, but
+// only if some thread has it with the GIL released (CONTEXT_RUN counts those
+// in gil_released, and so does a waiting IsolateLocker). Otherwise whoever has
+// the isolate also has the GIL or is about to give both back, and handing the
+// GIL around on every attribute read would just slow down threaded programs.
+inline PyThreadState *release_gil_if_contended(Isolate *isolate) {
+    if (Locker::IsLocked(isolate)) {
+        return NULL;
+    }
+    isolate_c *py_isolate = isolate_get_object(isolate);
+    if (py_isolate == NULL || py_isolate->gil_released == 0) {
+        return NULL;
+    }
+    py_isolate->gil_released++;
+    return PyEval_SaveThread();
+}
+class IsolateLocker {
+    public:
+        explicit IsolateLocker(Isolate *isolate)
+            : save_(release_gil_if_contended(isolate)), locker_(isolate) {
+            if (save_ != NULL) {
+                PyEval_RestoreThread(save_);
+                isolate_get_object(isolate)->gil_released--;
+            }
+        }
+    private:
+        PyThreadState *save_;
+        Locker locker_;
+};
+
+// Every callback from JavaScript into Python holds one of these for its
+// whole body. It's cheap when the GIL is already held.
+class GILEnsure {
+    public:
+        GILEnsure() : state_(PyGILState_Ensure()) {}
+        ~GILEnsure() { PyGILState_Release(state_); }
+    private:
+        PyGILState_STATE state_;
+};
+#define WITH_GIL GILEnsure gil_ensure
+
+// Both of these declare a local named isolate, which is what everything else
+// (JSTR, JS_TRY, the memes) expects to find in scope.
+#define IN_V8(iso) \
+    Isolate *isolate = (iso); \
+    IsolateLocker locker(isolate); \
     Isolate::Scope is(isolate); \
     USING_V8
-#define ESCAPING_IN_V8 \
-    Locker locker(isolate); \
+#define ESCAPING_IN_V8(iso) \
+    Isolate *isolate = (iso); \
+    IsolateLocker locker(isolate); \
     Isolate::Scope is(isolate); \
     ESCAPING_V8
+// For code that only ever runs with an isolate already entered
+#define CURRENT_ISOLATE \
+    Isolate *isolate = Isolate::GetCurrent()
 
 #define USING_V8 \
     HandleScope hs(isolate)
@@ -0,0 +1,390 @@
+#include <Python.h>
+#include "v8py.h"
+#include <v8.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "watchdog.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <mach/mach.h>
+#include <time.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+using namespace v8;
+
+// don't bother waking up more often than this to check a CPU budget
+#define MIN_CPU_CHECK_INTERVAL 0.001
+
+class Watchdog {
+    public:
+        void arm(Deadline *deadline);
+        void disarm(Deadline *deadline);
+        void run();
+        // starts the thread, false if it couldn't
+        bool start();
+
+#ifndef _WIN32
+        static void before_fork();
+        static void after_fork_parent();
+        static void after_fork_child();
+#endif
+
+        std::mutex mutex;
+    private:
+        void push(Deadline *deadline);
+        void remove(size_t index);
+        void sift_up(size_t index);
+        void sift_down(size_t index);
+        void place(size_t index, Deadline *deadline);
+
+        std::condition_variable wakeup_;
+        std::vector<Deadline *> heap_;
+        bool running_ = false;
+};
+
+// Never freed, the thread waiting on it is detached and outlives everything
+static Watchdog *watchdog = NULL;
+
+static void watchdog_thread(Watchdog *self) {
+    self->run();
+}
+
+int watchdog_init() {
+    if (watchdog != NULL) {
+        return 0;
+    }
+    watchdog = new Watchdog();
+    if (!watchdog->start()) {
+        PyErr_SetString(PyExc_OSError, "can't start the watchdog thread");
+        return -1;
+    }
+#ifndef _WIN32
+    pthread_atfork(Watchdog::before_fork, Watchdog::after_fork_parent, Watchdog::after_fork_child);
+#endif
+    return 0;
+}
+
+bool Watchdog::start() {
+    try {
+        std::thread(watchdog_thread, this).detach();
+        running_ = true;
+    } catch (const std::system_error &) {
+        running_ = false;
+    }
+    return running_;
+}
+
+#ifndef _WIN32
+// fork() only copies the thread that called it, so the child's watchdog has
+// no thread. The lock is held across the fork so the heap gets copied in one
+// piece. The child then moves the deadlines armed by the thread that forked
+// (the only one still around) onto a fresh watchdog, since the old condition
+// variable may still think the dead thread is waiting on it, and leaks the
+// old one like the first.
+void Watchdog::before_fork() {
+    watchdog->mutex.lock();
+}
+
+void Watchdog::after_fork_parent() {
+    watchdog->mutex.unlock();
+}
+
+void Watchdog::after_fork_child() {
+    Watchdog *old = watchdog;
+    watchdog = new Watchdog();
+    std::thread::id self = std::this_thread::get_id();
+    for (size_t i = 0; i < old->heap_.size(); i++) {
+        Deadline *deadline = old->heap_[i];
+        if (deadline->thread_ == self) {
+            watchdog->push(deadline);
+        } else {
+            deadline->armed_ = false;
+        }
+    }
+    old->mutex.unlock();
+    // if this fails, the next arm tries again
+    watchdog->start();
+}
+#endif
+
+void Watchdog::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        if (heap_.empty()) {
+            wakeup_.wait(lock);
+            continue;
+        }
+        Deadline *first = heap_[0];
+        watchdog_clock::time_point now = watchdog_clock::now();
+        if (first->when_ > now) {
+            wakeup_.wait_until(lock, first->when_);
+            continue;
+        }
+        remove(0);
+        if (first->expired(now)) {
+            first->armed_ = false;
+            first->fired_ = true;
+            first->isolate_->TerminateExecution();
+        } else {
+            push(first);
+        }
+    }
+}
+
+void Watchdog::arm(Deadline *deadline) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running_) {
+        // the thread just waits for the lock until we're done
+        start();
+    }
+    push(deadline);
+    deadline->armed_ = true;
+    // only bother the watchdog if it needs to wake up sooner than it planned
+    if (deadline->heap_index_ == 0) {
+        wakeup_.notify_one();
+    }
+}
+
+void Watchdog::disarm(Deadline *deadline) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (deadline->armed_) {
+        remove(deadline->heap_index_);
+        deadline->armed_ = false;
+    }
+}
+
+void Watchdog::place(size_t index, Deadline *deadline) {
+    heap_[index] = deadline;
+    deadline->heap_index_ = index;
+}
+
+void Watchdog::push(Deadline *deadline) {
+    heap_.push_back(deadline);
+    place(heap_.size() - 1, deadline);
+    sift_up(heap_.size() - 1);
+}
+
+void Watchdog::remove(size_t index) {
+    Deadline *last = heap_.back();
+    heap_.pop_back();
+    if (index == heap_.size()) {
+        return;
+    }
+    place(index, last);
+    sift_up(index);
+    sift_down(last->heap_index_);
+}
+
+void Watchdog::sift_up(size_t index) {
+    Deadline *deadline = heap_[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (heap_[parent]->when_ <= deadline->when_) {
+            break;
+        }
+        place(index, heap_[parent]);
+        index = parent;
+    }
+    place(index, deadline);
+}
+
+void Watchdog::sift_down(size_t index) {
+    Deadline *deadline = heap_[index];
+    size_t size = heap_.size();
+    for (;;) {
+        size_t child = index * 2 + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && heap_[child + 1]->when_ < heap_[child]->when_) {
+            child++;
+        }
+        if (deadline->when_ <= heap_[child]->when_) {
+            break;
+        }
+        place(index, heap_[child]);
+        index = child;
+    }
+    place(index, deadline);
+}
+
+Deadline::Deadline(Isolate *isolate, double timeout, double cpu_timeout)
+    : isolate_(isolate), parent_(NULL), has_wall_(timeout > 0), cpu_budget_(0), cpu_start_(0),
+    thread_(std::this_thread::get_id()), heap_index_(0), timed_(false), armed_(false), fired_(false) {
+    watchdog_clock::time_point now = watchdog_clock::now();
+    if (has_wall_) {
+        wall_when_ = now + std::chrono::duration_cast<watchdog_clock::duration>(
+                std::chrono::duration<double>(timeout));
+        when_ = wall_when_;
+    }
+    if (cpu_timeout > 0 && cpu_clock_.open()) {
+        cpu_budget_ = cpu_timeout;
+        cpu_start_ = cpu_clock_.now();
+        watchdog_clock::time_point cpu_when = now + std::chrono::duration_cast<watchdog_clock::duration>(
+                std::chrono::duration<double>(cpu_timeout));
+        if (!has_wall_ || cpu_when < when_) {
+            when_ = cpu_when;
+        }
+    }
+    timed_ = has_wall_ || cpu_budget_ > 0;
+
+    if (timed_) {
+        isolate_c *py_isolate = isolate_get_object(isolate);
+        parent_ = py_isolate->deadlines;
+        py_isolate->deadlines = this;
+        watchdog->arm(this);
+    }
+}
+
+bool Deadline::expired(watchdog_clock::time_point now) {
+    if (has_wall_ && wall_when_ <= now) {
+        return true;
+    }
+    if (cpu_budget_ <= 0) {
+        // not possible, when_ was the wall deadline
+        return true;
+    }
+    double remaining = cpu_budget_ - (cpu_clock_.now() - cpu_start_);
+    if (remaining <= 0) {
+        return true;
+    }
+    if (remaining < MIN_CPU_CHECK_INTERVAL) {
+        remaining = MIN_CPU_CHECK_INTERVAL;
+    }
+    when_ = now + std::chrono::duration_cast<watchdog_clock::duration>(
+            std::chrono::duration<double>(remaining));
+    if (has_wall_ && wall_when_ < when_) {
+        when_ = wall_when_;
+    }
+    return false;
+}
+
+Deadline::~Deadline() {
+    if (!timed_) {
+        return;
+    }
+    watchdog->disarm(this);
+
+    // Scopes normally end in reverse order, but a greenlet switch can
+    // interleave two stacks on one isolate, so unlink from wherever we are.
+    isolate_c *py_isolate = isolate_get_object(isolate_);
+    Deadline **link = &py_isolate->deadlines;
+    while (*link != NULL && *link != this) {
+        link = &(*link)->parent_;
+    }
+    if (*link == this) {
+        *link = parent_;
+    }
+
+    // If this deadline fired, either the JavaScript inside it got terminated
+    // or it finished just before and the termination is still pending. Either
+    // way, unless an enclosing deadline also expired, the code outside this
+    // scope still has budget left and should keep running.
+    if (fired() && !enclosing_fired()) {
+        isolate_->CancelTerminateExecution();
+    }
+}
+
+bool Deadline::fired() {
+    if (!timed_) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(watchdog->mutex);
+    return fired_;
+}
+
+bool Deadline::enclosing_fired() {
+    std::lock_guard<std::mutex> lock(watchdog->mutex);
+    for (Deadline *deadline = parent_; deadline != NULL; deadline = deadline->parent_) {
+        if (deadline->fired_) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ThreadClock::~ThreadClock() {
+#ifdef _WIN32
+    if (opened_) {
+        CloseHandle((HANDLE) handle_);
+    }
+#endif
+}
+
+bool ThreadClock::open() {
+#if defined(_WIN32)
+    HANDLE thread;
+    opened_ = DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(),
+            &thread, 0, FALSE, DUPLICATE_SAME_ACCESS) != 0;
+    handle_ = (uintptr_t) thread;
+#elif defined(__APPLE__)
+    handle_ = (uintptr_t) pthread_mach_thread_np(pthread_self());
+    opened_ = true;
+#else
+    clockid_t clock;
+    opened_ = pthread_getcpuclockid(pthread_self(), &clock) == 0;
+    handle_ = (uintptr_t) clock;
+#endif
+    return opened_;
+}
+
+#ifdef _WIN32
+static double filetime_seconds(const FILETIME &time) {
+    ULARGE_INTEGER value;
+    value.LowPart = time.dwLowDateTime;
+    value.HighPart = time.dwHighDateTime;
+    // 100 nanosecond units
+    return value.QuadPart / 1e7;
+}
+
+static double thread_handle_cpu_time(HANDLE thread) {
+    FILETIME creation, exited, kernel, user;
+    if (!GetThreadTimes(thread, &creation, &exited, &kernel, &user)) {
+        return 0;
+    }
+    return filetime_seconds(kernel) + filetime_seconds(user);
+}
+#endif
+
+double ThreadClock::now() {
+#if defined(_WIN32)
+    return thread_handle_cpu_time((HANDLE) handle_);
+#elif defined(__APPLE__)
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    if (thread_info((mach_port_t) handle_, THREAD_BASIC_INFO, (thread_info_t) &info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.user_time.seconds + info.user_time.microseconds / 1e6 +
+        info.system_time.seconds + info.system_time.microseconds / 1e6;
+#else
+    struct timespec time;
+    if (clock_gettime((clockid_t) handle_, &time) != 0) {
+        return 0;
+    }
+    return time.tv_sec + time.tv_nsec / 1e9;
+#endif
+}
+
+double thread_cpu_time() {
+#ifdef _WIN32
+    return thread_handle_cpu_time(GetCurrentThread());
+#else
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+        return 0;
+    }
+    return time.tv_sec + time.tv_nsec / 1e9;
+#endif
+}
@@ -0,0 +1,109 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <Python.h>
+#include <v8.h>
+#include <chrono>
+#include <stdint.h>
+#include <thread>
+
+using namespace v8;
+
+// Timeouts are enforced by a single watchdog thread that lives as long as the
+// process. It keeps every armed Deadline in a heap ordered by expiry, sleeps
+// until the earliest one and terminates the isolate it belongs to. Arming and
+// disarming a deadline is a heap insert or removal under an uncontended lock,
+// so code paths that arm a timeout on every property access stay cheap.
+// After a fork the child starts its own watchdog thread.
+typedef std::chrono::steady_clock watchdog_clock;
+
+// The CPU clock of the thread that opened it, which any thread can read.
+class ThreadClock {
+    public:
+        ThreadClock() : opened_(false), handle_(0) {}
+        ~ThreadClock();
+        bool open();
+        // seconds of CPU time the thread has used
+        double now();
+
+    private:
+        ThreadClock(const ThreadClock &);
+        ThreadClock &operator=(const ThreadClock &);
+
+        bool opened_;
+        // a clockid_t, mach thread port or HANDLE depending on the platform
+        uintptr_t handle_;
+};
+
+// CPU time used by the calling thread, in seconds
+double thread_cpu_time();
+
+// Adds up the CPU time the calling thread spends while it's in scope
+class CPUMeter {
+    public:
+        CPUMeter(double *last, double *total) : last_(last), total_(total), start_(thread_cpu_time()) {}
+        ~CPUMeter() {
+            *last_ = thread_cpu_time() - start_;
+            *total_ += *last_;
+        }
+
+    private:
+        double *last_;
+        double *total_;
+        double start_;
+};
+
+// A Deadline is armed for as long as it's in scope. A timeout of 0 or less
+// means no deadline.
+//
+// The timeout is wall clock time. A cpu_timeout limits the CPU time used by
+// the thread that armed the deadline instead, so a script doesn't get killed
+// because the box was busy and it wasn't scheduled. CPU time can't pass
+// faster than wall time, so the watchdog checks the thread's CPU clock when
+// the remaining budget would run out and reschedules the check if it hasn't.
+//
+// Deadlines nest: JavaScript calls Python which calls back into JavaScript
+// with its own timeout. Each isolate keeps a stack of its armed deadlines and
+// the watchdog fires whichever one expires first. Terminating an isolate
+// unwinds all of its JavaScript, so when a deadline's scope ends it decides
+// whether the termination stops there: if this deadline fired but none of
+// the enclosing ones did, execution is resumed and only the frames inside
+// this deadline end up as JavaScriptTerminated.
+class Deadline {
+    public:
+        Deadline(Isolate *isolate, double timeout, double cpu_timeout = 0);
+        ~Deadline();
+
+        // true if the deadline expired and the isolate was terminated
+        bool fired();
+
+    private:
+        Deadline(const Deadline &);
+        Deadline &operator=(const Deadline &);
+
+        bool enclosing_fired();
+        // true if the budget is used up, otherwise moves when_ to the next check
+        bool expired(watchdog_clock::time_point now);
+
+        friend class Watchdog;
+        Isolate *isolate_;
+        // the next deadline down the isolate's stack
+        Deadline *parent_;
+        // when the watchdog looks at this deadline next
+        watchdog_clock::time_point when_;
+        bool has_wall_;
+        watchdog_clock::time_point wall_when_;
+        double cpu_budget_;
+        double cpu_start_;
+        ThreadClock cpu_clock_;
+        // the thread that armed it, which is the one that survives a fork
+        std::thread::id thread_;
+        size_t heap_index_;
+        bool timed_;
+        bool armed_;
+        bool fired_;
+};
+
+int watchdog_init();
+
+#endif